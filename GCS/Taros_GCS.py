@@ -23,6 +23,56 @@ def format_time(t):
     ms = ms-s*1000
     return "%02d:%02d:%02d.%03d" % (h,m,s,ms)
 
+# the message types of the TAROS downlink (0xCCxx, see src/message.h) :
+# 0x81 system, 0x88 ping response (from the modem), 0x89 telemetry variable
+# and the data messages with the struct formats of their values
+DATA_FORMATS = { 0x90 : 'h', 0x98 : 'f', 0x99 : 'd', 0xA0 : 'ddf' }
+FRAME_TYPES = [ 0x81, 0x88, 0x89 ] + list(DATA_FORMATS)
+
+def frame_size(msb, lsb, n_bytes):
+    """
+    The number of bytes of a frame with the given header including the RSI
+    appended by the modem, 0 if it is no known message.
+    A frame consists of type (2 bytes), length n_bytes, n_bytes of sender and data
+    and the CRC-16 (2 bytes). The ping response of the modem has no CRC.
+    """
+    if msb != 0xCC or lsb not in FRAME_TYPES:
+        return 0
+    if lsb == 0x88:
+        return n_bytes+4
+    return n_bytes+6
+
+def crc16_ccitt(data):
+    """
+    The CRC-16 CCITT (polynomial 0x1021, start 0xFFFF) as computed by crc16() in src/util.cpp.
+    """
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for bit in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+        crc &= 0xFFFF
+    return crc
+
+def level_color(level):
+    """
+    The color in which system messages of the given level are shown.
+    """
+    if level==1: # MSG_LEVEL_FATALERROR
+        return QColor.fromRgb(200, 0, 0)
+    elif level==3: # MSG_LEVEL_CRITICAL
+        return QColor.fromRgb(255, 0, 0)
+    elif level==5: # MSG_LEVEL_MILESTONE
+        return QColor.fromRgb(0, 200, 0)
+    elif level==8: # MSG_LEVEL_ERROR
+        return QColor.fromRgb(255, 200, 200)
+    elif level==10: # MSG_LEVEL_STATE_CHANGE
+        return QColor.fromRgb(200, 255, 200)
+    elif level==12: # MSG_LEVEL_WARNING
+        return QColor.fromRgb(255, 255, 100)
+    else: # MSG_LEVEL_STATUSREPORT
+        return QColor.fromRgb(210, 210, 210)
+
 class CommunicationsView(QWidget):
     
     def __init__(self, main_window):
@@ -36,6 +86,8 @@ class CommunicationsView(QWidget):
         self.port = None
         # receive buffer for the messages
         self.receive_buffer = bytearray(b'')
+        # the telemetry variables declared so far : hash -> (sender, name)
+        self.variables = {}
         # the left side - message table
         self.table = QTableWidget()
         self.table.setRowCount(0)
@@ -111,92 +163,80 @@ class CommunicationsView(QWidget):
         #     line += (" %0.2X" % c)
         # print(line)
         
-        found = False
-        empty = len(self.receive_buffer) < 3
-        while not (found or empty):
+        # handle all complete frames in the buffer
+        while len(self.receive_buffer) >= 3:
             msb, lsb, n_bytes = unpack('BBB', self.receive_buffer[:3])
-            # if it ihas a message header
-            if msb == 204:
-                # if it is a system message or a ping response
-                if lsb == 129 or lsb == 136:
-                    if len(self.receive_buffer) >= n_bytes+3:
-                        found = True
-                    else:
-                        empty = True
-            if not (found or empty):
+            size = frame_size(msb, lsb, n_bytes)
+            if size == 0:
+                # no known message header - resync
                 self.receive_buffer.pop(0)
-                empty = len(self.receive_buffer) < 3
-                
-        if found:
-            msg = self.receive_buffer[0:n_bytes+4]
-            del self.receive_buffer[0:n_bytes+4]
-            msb, lsb, n_bytes = unpack('BBB', msg[:3])
-            # if it ihas a message header
-            if msb == 204:
-                # if it is a system message
-                if lsb == 129:
-                    sender = msg[3:11].decode(encoding='utf-8')
-                    self.next_index = self.table.rowCount()
-                    self.table.insertRow(self.next_index)
-                    self.table.setRowCount(self.next_index+1)
-                    level = msg[11]
-                    if level==1: # MSG_LEVEL_FATALERROR
-                        col = QColor.fromRgb(200, 0, 0)
-                    elif level==3: # MSG_LEVEL_CRITICAL
-                        col = QColor.fromRgb(255, 0, 0)
-                    elif level==5: # MSG_LEVEL_MILESTONE
-                        col = QColor.fromRgb(0, 200, 0)
-                    elif level==8: # MSG_LEVEL_ERROR
-                        col = QColor.fromRgb(255, 200, 200)
-                    elif level==10: # MSG_LEVEL_STATE_CHANGE
-                        col = QColor.fromRgb(200, 255, 200)
-                    elif level==12: # MSG_LEVEL_WARNING
-                        col = QColor.fromRgb(255, 255, 100)
-                    else: # MSG_LEVEL_STATUSREPORT
-                        col = QColor.fromRgb(210, 210, 210)
-                    sender_item = QTableWidgetItem(sender)
-                    sender_item.setBackground(col)
-                    self.table.setItem(self.next_index, 0, sender_item)
-                    time, = unpack('I', msg[12:16])
-                    time_item = QTableWidgetItem(format_time(time))
-                    time_item.setBackground(col)
-                    self.table.setItem(self.next_index, 1, time_item)
-                    text = msg[16:n_bytes+3].decode(encoding='utf-8')
-                    text_item = QTableWidgetItem(text)
-                    text_item.setBackground(col)
-                    self.table.setItem(self.next_index, 2, text_item)
-                    rsi = msg[n_bytes+3]
-                    rsi_item = QTableWidgetItem("%3d"%rsi)
-                    rsi_item.setBackground(col)
-                    self.table.setItem(self.next_index, 3, rsi_item)
-                    # print("%3d"%level, sender, format_time(time), text)
-                    self.table.setCurrentCell(self.next_index, 0)
-                # if it is a ping response
-                elif lsb == 136:
-                    # print("ping received")
-                    self.next_index = self.table.rowCount()
-                    self.table.insertRow(self.next_index)
-                    self.table.setRowCount(self.next_index+1)
-                    level = 0
-                    col = QColor.fromRgb(210, 210, 210)
-                    sender_item = QTableWidgetItem("")
-                    sender_item.setBackground(col)
-                    self.table.setItem(self.next_index, 0, sender_item)
-                    time_item = QTableWidgetItem("")
-                    time_item.setBackground(col)
-                    self.table.setItem(self.next_index, 1, time_item)
-                    up_rsi = msg[5]
-                    down_rsi = msg[6]
-                    text = f'ping RSI up={up_rsi} down = {down_rsi}'
-                    text_item = QTableWidgetItem(text)
-                    text_item.setBackground(col)
-                    self.table.setItem(self.next_index, 2, text_item)
-                    # the RSI is appended after the counted payload bytes
-                    rsi = msg[n_bytes+3]
-                    rsi_item = QTableWidgetItem("%3d"%rsi)
-                    rsi_item.setBackground(col)
-                    self.table.setItem(self.next_index, 3, rsi_item)
-                    self.table.setCurrentCell(self.next_index, 0)
+                continue
+            if len(self.receive_buffer) < size:
+                # wait for the rest of the frame
+                break
+            msg = bytes(self.receive_buffer[0:size])
+            # the frames of the TAROS codec are protected by a CRC
+            if lsb != 136:
+                crc, = unpack('>H', msg[n_bytes+3:n_bytes+5])
+                if crc != crc16_ccitt(msg[:n_bytes+3]):
+                    # not a valid frame - resync
+                    self.receive_buffer.pop(0)
+                    continue
+            del self.receive_buffer[0:size]
+            # the RSI is appended by the modem after the frame
+            rsi = msg[size-1]
+            # if it is a system message
+            if lsb == 129:
+                sender = msg[3:11].decode(encoding='utf-8')
+                level = msg[11]
+                time, = unpack('<I', msg[12:16])
+                # the text is preceded by its character count
+                count = msg[16]
+                text = msg[17:17+count].decode(encoding='utf-8', errors='replace')
+                # print("%3d"%level, sender, format_time(time), text)
+                self.add_row(sender, format_time(time), text, rsi, level_color(level))
+            # if it is the declaration of a telemetry variable
+            elif lsb == 137:
+                sender = msg[3:11].decode(encoding='utf-8')
+                hash, count = unpack('<HB', msg[11:14])
+                name = msg[14:14+count].decode(encoding='utf-8', errors='replace')
+                self.variables[hash] = (sender, name)
+                text = f'telemetry variable {name} (hash=0x{hash:04X})'
+                self.add_row(sender, "", text, rsi, QColor.fromRgb(210, 210, 210))
+            # if it is a data message
+            elif lsb in DATA_FORMATS:
+                hash, time = unpack('<HI', msg[3:9])
+                fmt = DATA_FORMATS[lsb]
+                # the number of values follows from the frame length
+                if fmt == 'ddf':
+                    values = unpack('<ddf', msg[9:29]) if n_bytes == 26 else ()
+                else:
+                    width = calcsize(fmt)
+                    values = unpack('<%d%s' % ((n_bytes-6)//width, fmt), msg[9:9+n_bytes-6])
+                sender, name = self.variables.get(hash, ("", "#%04X" % hash))
+                text = name + " : " + ", ".join("%g" % v for v in values)
+                self.add_row(sender, format_time(time), text, rsi, QColor.fromRgb(210, 210, 255))
+            # if it is a ping response
+            elif lsb == 136:
+                # print("ping received")
+                up_rsi = msg[5]
+                down_rsi = msg[6]
+                text = f'ping RSI up={up_rsi} down = {down_rsi}'
+                self.add_row("", "", text, rsi, QColor.fromRgb(210, 210, 210))
+            # all other messages are ignored
+
+    def add_row(self, sender, time, text, rsi, col):
+        """
+        Append a message to the table.
+        """
+        self.next_index = self.table.rowCount()
+        self.table.insertRow(self.next_index)
+        self.table.setRowCount(self.next_index+1)
+        for column, value in enumerate([sender, time, text, "%3d"%rsi]):
+            item = QTableWidgetItem(value)
+            item.setBackground(col)
+            self.table.setItem(self.next_index, column, item)
+        self.table.setCurrentCell(self.next_index, 0)
 
     def clear_list(self):
         """
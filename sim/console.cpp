@@ -0,0 +1,24 @@
+#include <cstdio>
+
+#include "console.h"
+
+ConsoleWriter::ConsoleWriter(std::string name) : Module(name)
+{
+    runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
+    quiet = false;
+    in.set_handler(this, TaskDelegate::create<ConsoleWriter, &ConsoleWriter::handle_MSG>(this));
+}
+
+void ConsoleWriter::handle_MSG()
+{
+    while (in.count()>0)
+    {
+        Message msg = in.fetch();
+        if (!quiet)
+        {
+            size_t n = msg.printout(line, MSG_MAX_PRINTOUT+1);
+            line[n++] = '\n';
+            fwrite(line, 1, n, stdout);
+        };
+    };
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+#include "module.h"
+#include "message.h"
+#include "port.h"
+
+/*  
+    This is a module for the host simulation.
+    It prints all received messages (serialized) to the console.
+*/
+class ConsoleWriter : public Module
+{
+
+public:
+
+    // constructor
+    ConsoleWriter(std::string name);
+    
+    // nothing to do
+    virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
+    
+    // print all messages waiting at the input port
+    // this is scheduled when a message arrives
+    void handle_MSG();
+
+    // destructor
+    virtual ~ConsoleWriter() {};
+
+    // port at which messages are received to be printed
+    ReceiverPort in;
+
+    // when set, nothing is printed (messages are still consumed)
+    bool quiet;
+
+private:
+
+    // one formatted message with LF
+    char line[MSG_MAX_PRINTOUT+2];
+
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <cmath>
+
+#include "core_pins.h"
@@ -0,0 +1,57 @@
+/*
+    A stand-in for the SD library used by the host simulation.
+    Files are created in the current working directory of the host.
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+#define FILE_READ 0
+#define FILE_WRITE 1
+
+#define BUILTIN_SDCARD 254
+
+class File
+{
+
+public:
+
+    File() : fp(0) {};
+    File(FILE *f) : fp(f) {};
+
+    operator bool() { return fp != 0; };
+
+    size_t write(const void *buf, size_t size)
+        { return (fp != 0) ? fwrite(buf, 1, size, fp) : 0; };
+    size_t write(uint8_t b) { return write(&b, 1); };
+    int read(void *buf, size_t size)
+        { return (fp != 0) ? (int)fread(buf, 1, size, fp) : -1; };
+    void flush() { if (fp != 0) fflush(fp); };
+    void close() { if (fp != 0) fclose(fp); fp = 0; };
+
+private:
+
+    FILE *fp;
+
+};
+
+class SDClass
+{
+
+public:
+
+    bool begin(uint8_t csPin) { return true; };
+
+    File open(const char *filepath, uint8_t mode = FILE_READ)
+        { return File(fopen(filepath, (mode == FILE_WRITE) ? "ab" : "rb")); };
+
+    bool exists(const char *filepath);
+
+    bool remove(const char *filepath);
+
+};
+
+extern SDClass SD;
@@ -0,0 +1,45 @@
+/*
+    This is a stand-in for the Teensyduino core used by the host simulation.
+    It provides just those parts of the core that are used by the kernel
+    and the hardware-independent modules.
+    
+    The CPU cycle counter is a virtual one, it advances by a fixed number
+    of cycles every time it is read (and with every delay). Whenever it crosses
+    a millisecond boundary the systick interrupt is delivered, unless
+    interrupts are disabled at that time (then it is delivered when they are
+    enabled again). This way a simulation runs as fast as the host CPU allows
+    and always produces the same sequence of events.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// the CPU clock of the simulated Teensy 4.1
+#define F_CPU 600000000
+extern volatile uint32_t F_CPU_ACTUAL;
+
+// the virtual cycle counter
+extern "C" uint32_t sim_cycle_count();
+#define ARM_DWT_CYCCNT (sim_cycle_count())
+
+// interrupts only have to be blocked against the systick
+void sim_disable_irq();
+void sim_enable_irq();
+#define __disable_irq() sim_disable_irq()
+#define __enable_irq() sim_enable_irq()
+// the interrupt mask register (1 if interrupts are disabled)
+uint32_t sim_get_primask();
+void sim_set_primask(uint32_t primask);
+#define __get_PRIMASK() sim_get_primask()
+#define __set_PRIMASK(primask) sim_set_primask(primask)
+
+// the interrupt vector table, only the systick vector (15) is used
+#define NVIC_NUM_INTERRUPTS 160
+extern void (* _VectorsRam[NVIC_NUM_INTERRUPTS+16])(void);
+
+// these advance the virtual clock
+void delayMicroseconds(uint32_t usec);
+void delay(uint32_t msec);
+uint32_t millis();
+uint32_t micros();
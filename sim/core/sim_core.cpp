@@ -0,0 +1,135 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "core_pins.h"
+#include "sim_core.h"
+#include "SD.h"
+
+volatile uint32_t F_CPU_ACTUAL = F_CPU;
+
+void (* _VectorsRam[NVIC_NUM_INTERRUPTS+16])(void);
+
+// These 2 variables are part of the Teensyduino core.
+// They are maintained by the kernel ISR.
+extern "C" volatile uint32_t systick_cycle_count;
+extern "C" volatile uint32_t systick_millis_count;
+volatile uint32_t systick_cycle_count;
+volatile uint32_t systick_millis_count;
+
+// the memory layout symbols used by the watchdog memory report
+unsigned long _heap_start;
+unsigned long _heap_end;
+char *__brkval;
+unsigned long _estack;
+
+SDClass SD;
+
+bool SDClass::exists(const char *filepath)
+{
+    FILE *f = fopen(filepath, "rb");
+    if (f == 0) return false;
+    fclose(f);
+    return true;
+}
+
+bool SDClass::remove(const char *filepath)
+{
+    return ::remove(filepath) == 0;
+}
+
+// the state of the virtual CPU
+static uint64_t sim_cycles = 0;
+static uint64_t sim_next_tick = F_CPU/1000;
+static uint64_t sim_end_tick = 0;
+static uint32_t sim_cycles_per_read = SIM_CYCLES_PER_READ;
+static bool sim_irq_disabled = false;
+static bool sim_in_isr = false;
+static void (*sim_finish)() = 0;
+
+// deliver all systicks that are due
+static void sim_deliver()
+{
+    if (sim_irq_disabled or sim_in_isr) return;
+    while (sim_cycles >= sim_next_tick)
+    {
+        uint64_t tick = sim_next_tick / (F_CPU/1000);
+        sim_next_tick += F_CPU/1000;
+        sim_in_isr = true;
+        if (_VectorsRam[15] != 0) _VectorsRam[15]();
+        sim_in_isr = false;
+        if ((sim_end_tick != 0) and (tick >= sim_end_tick))
+        {
+            if (sim_finish != 0) sim_finish();
+            exit(0);
+        };
+    };
+}
+
+extern "C" uint32_t sim_cycle_count()
+{
+    sim_cycles += sim_cycles_per_read;
+    sim_deliver();
+    return (uint32_t)sim_cycles;
+}
+
+void sim_disable_irq()
+{
+    sim_irq_disabled = true;
+}
+
+void sim_enable_irq()
+{
+    sim_irq_disabled = false;
+    sim_deliver();
+}
+
+uint32_t sim_get_primask()
+{
+    return sim_irq_disabled ? 1 : 0;
+}
+
+void sim_set_primask(uint32_t primask)
+{
+    if (primask & 1)
+        sim_disable_irq();
+    else
+        sim_enable_irq();
+}
+
+void delayMicroseconds(uint32_t usec)
+{
+    sim_cycles += (uint64_t)usec * (F_CPU/1000000);
+    sim_deliver();
+}
+
+void delay(uint32_t msec)
+{
+    sim_cycles += (uint64_t)msec * (F_CPU/1000);
+    sim_deliver();
+}
+
+uint32_t millis()
+{
+    return (uint32_t)(sim_cycles / (F_CPU/1000));
+}
+
+uint32_t micros()
+{
+    return (uint32_t)(sim_cycles / (F_CPU/1000000));
+}
+
+void sim_run_until(uint32_t msec, void (*finish)())
+{
+    sim_end_tick = msec;
+    sim_finish = finish;
+}
+
+void sim_set_cycles_per_read(uint32_t cycles)
+{
+    sim_cycles_per_read = cycles;
+}
+
+uint64_t sim_elapsed_cycles()
+{
+    return sim_cycles;
+}
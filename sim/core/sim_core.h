@@ -0,0 +1,21 @@
+/*
+    Control of the virtual CPU of the host simulation.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// the number of CPU cycles that pass with every read of ARM_DWT_CYCCNT
+// this is the only measure of the time spent computing in the simulation
+#define SIM_CYCLES_PER_READ 50
+
+// Stop the simulation when the given system time (in ms) has been reached.
+// The given function is called (from within the systick) before the program exits.
+void sim_run_until(uint32_t msec, void (*finish)());
+
+// change the simulated computing time
+void sim_set_cycles_per_read(uint32_t cycles);
+
+// the total number of CPU cycles simulated so far
+uint64_t sim_elapsed_cycles();
@@ -0,0 +1,99 @@
+/*
+    This is the main program of the host simulation.
+    It sets up the same kernel as on the Teensy and runs the system
+    on a virtual clock (see core/core_pins.h) for the given time.
+
+    usage : taros_sim [-t seconds] [-c cycles] [-q]
+        -t  the system time to be simulated (default 60 s)
+        -c  the CPU cycles per read of the cycle counter (default 50)
+        -q  do not print the messages to the console
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <list>
+#include <sstream>
+
+#include "kernel.h"
+#include "global.h"
+#include "module.h"
+#include "message.h"
+#include "system.h"
+#include "sim_core.h"
+
+#ifndef VERSION_MAJOR
+#define VERSION_MAJOR 0
+#define VERSION_MINOR 0
+#define VERSION_BUILD 0
+#endif
+
+bool SD_card_OK;
+int SD_file_No;
+Logger *system_log;
+FileWriter* system_log_file_writer = 0;
+
+static std::chrono::steady_clock::time_point wall_start;
+
+// called when the simulated time has elapsed
+static void finish()
+{
+    // all messages still waiting are printed
+    system_log->run();
+    console->handle_MSG();
+    double wall = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wall_start).count();
+    double sim = 1e-3 * FC_time_now();
+    fprintf(stderr, "simulated %.3f s in %.3f s (%.0fx real time)\n", sim, wall, sim/wall);
+    FC_destroy_system(&module_list);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t run_time = 60;
+    bool quiet = false;
+    for (int i=1; i<argc; i++)
+    {
+        if ((strcmp(argv[i], "-t") == 0) and (i+1 < argc))
+            run_time = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "-c") == 0) and (i+1 < argc))
+            sim_set_cycles_per_read(atoi(argv[++i]));
+        else if (strcmp(argv[i], "-q") == 0)
+            quiet = true;
+        else
+        {
+            fprintf(stderr, "usage : %s [-t seconds] [-c cycles] [-q]\n", argv[0]);
+            return 1;
+        };
+    };
+    sim_run_until(1000*run_time, &finish);
+    wall_start = std::chrono::steady_clock::now();
+
+    system_log = new Logger("SYSLOG");
+    module_list.push_back(system_log);
+    std::stringstream msg;
+    msg << "TAROS host simulation - Version ";
+    msg << VERSION_MAJOR << "." << VERSION_MINOR << " - Build #" << VERSION_BUILD;
+    system_log->in.receive(
+        Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, msg.str()) );
+
+    // no log files are written by the simulation
+    SD_card_OK = false;
+    SD_file_No = 0;
+
+    setup_core_system();
+	FC_init_system();
+    console->quiet = quiet;
+    FC_setup_system(&module_list);
+    FC_build_system();
+
+    system_log->in.receive(
+        Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, "entering event loop.") );
+    FC_module_interrupts_activate();
+	kernel_loop();
+
+    // we will never get here, the simulation ends in finish()
+    return 0;
+}
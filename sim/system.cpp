@@ -0,0 +1,76 @@
+#include <functional>
+
+#include "global.h"
+#include "system.h"
+
+Commander *commander;
+Watchdog *watchdog;
+DummyGPS *gps;
+Requester *gps_logger;
+ConsoleWriter *console;
+
+void FC_init_system()
+{
+    // all text messages are printed to the console
+    console = new ConsoleWriter(std::string("CONSOLE"));
+    system_log->text_out.set_receiver(&(console->in));
+
+    // create a watchdog generating health analyzes every 5 seconds
+    watchdog = new Watchdog(std::string("WATCHDOG"), 5000);
+    watchdog->status_out.set_receiver(&(system_log->in));
+
+    commander = new Commander(std::string("COMMAND"));
+    commander->status_out.set_receiver(&(system_log->in));
+    
+    // create a simulated GPS module
+    gps = new DummyGPS(std::string("GPS_1"), 5.0, 0.2);
+    gps->status_out.set_receiver(&(system_log->in));
+
+    // create a logger capturing the GPS position every 10 seconds
+    gps_logger = new Requester(std::string("LOG_10S"), 0.1);
+
+    system_log->in.receive(
+        Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, "init() complete.")
+    );
+}
+
+void FC_setup_system(
+    std::list<Module*> *module_list
+)
+{
+    Module* modules[] = { console, watchdog, commander, gps, gps_logger };
+    for (Module* mod : modules)
+    {
+        mod->setup();
+        if (mod->state() >= MODULE_RUNLEVEL_SETUP_OK)
+            module_list->push_back(mod);
+    };
+	
+    system_log->in.receive(
+        Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, "all setup() complete.")
+    );
+}
+
+void FC_build_system()
+{
+    // wire the simulated GPS module
+    gps->tm_out.set_receiver(&(system_log->in));
+    
+    // the requested positions are printed as text
+    gps_logger->out.set_receiver(&(console->in));
+    auto callback = std::bind(&DummyGPS::get_position, gps); 
+    gps_logger->register_server_callback(callback, "GPS_1");
+    
+    system_log->in.receive(
+        Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, "build() complete.")
+    );
+}
+
+void FC_destroy_system(
+    std::list<Module*> *module_list
+)
+{
+    for (Module* mod : *module_list)
+        delete mod;
+    module_list->clear();
+}
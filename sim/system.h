@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+
+#include "module.h"
+#include "message.h"
+
+#include "commander.h"
+#include "dummy_gps.h"
+#include "watchdog.h"
+#include "console.h"
+
+/*
+    This is the system run by the host simulation.
+    It contains only modules that do not need any hardware.
+    The functions have the same purpose as in src/system.h
+*/
+
+// all modules that will be included during the system build
+extern Commander *commander;
+extern Watchdog *watchdog;
+extern DummyGPS *gps;
+extern Requester *gps_logger;
+extern ConsoleWriter *console;
+
+// -- actually defined in main.cpp --
+extern Logger* system_log;
+extern FileWriter* system_log_file_writer;
+
+void FC_init_system();
+
+void FC_setup_system(
+    std::list<Module*> *module_list
+);
+
+void FC_build_system();
+
+void FC_destroy_system(
+    std::list<Module*> *module_list
+);
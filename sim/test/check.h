@@ -0,0 +1,33 @@
+/*
+    A minimal frame for the host tests.
+    Every failed check is printed, the test program returns
+    the number of failed checks as exit code.
+*/
+
+#pragma once
+
+#include <cstdio>
+
+static int check_failures = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { \
+        printf("%s:%d: check failed : %s\n", __FILE__, __LINE__, #cond); \
+        check_failures++; } } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { long long _a = (long long)(a); long long _b = (long long)(b); \
+        if (_a != _b) { \
+        printf("%s:%d: check failed : %s == %s (%lld != %lld)\n", \
+            __FILE__, __LINE__, #a, #b, _a, _b); \
+        check_failures++; } } while (0)
+
+// print the result and return the exit code of the test
+static inline int check_result(const char *name)
+{
+    if (check_failures == 0)
+        printf("%s : passed\n", name);
+    else
+        printf("%s : %d checks FAILED\n", name, check_failures);
+    return check_failures;
+}
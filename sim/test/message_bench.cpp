@@ -0,0 +1,67 @@
+/*
+    Throughput of constructing, copying and destroying messages.
+
+    For every message type of message.h a message is constructed,
+    copied to two receivers (as a SenderPort with two receivers would do)
+    and all three are destroyed again. The benchmark is built for several
+    sizes of the inline data area (make bench), a size of 0 means that
+    all data are taken from the message pool.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "message.h"
+
+#define ITERATIONS 2000000
+
+// keep the compiler from optimizing the work away
+static volatile uint32_t sink;
+
+template<typename F>
+static void bench(const char *name, F make)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i=0; i<ITERATIONS; i++)
+    {
+        Message msg = make();
+        Message copy1(msg);
+        Message copy2(msg);
+        sink = sink + copy1.size() + copy2.size();
+    };
+    double ns = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+    printf("  %-22s %6.1f ns\n", name, ns);
+}
+
+int main()
+{
+    printf("inline data size %d bytes, Message %d bytes\n",
+        MESSAGE_INLINE_SIZE, (int)sizeof(Message));
+    printf("  construct + 2 copies + destroy :\n");
+    uint16_t sender = 1;
+    MSG_DATA_GPS_POSITION gps = { 48.1, 11.5, 520.0 };
+    MSG_DATA_SERVO servo = { { 1, 2, 3, 4, 5, 6, 7, 8 } };
+    float ahrs[3] = { 1.0, 2.0, 3.0 };
+    std::string short_text("file opened.");
+    std::string long_text("Message pool -- 16 : 0/128 -- 32 : 2/128 -- 64 : 7/64 -- 128 : 2/32");
+    bench("PING", [&]() {
+        return Message(sender, MSG_TYPE_PING, 0, NULL); });
+    bench("SERVO (16)", [&]() {
+        return Message(sender, MSG_TYPE_SERVO, sizeof(servo), &servo); });
+    bench("IMU_AHRS (12)", [&]() {
+        return Message(sender, MSG_TYPE_IMU_AHRS, sizeof(ahrs), ahrs); });
+    bench("GPS_POSITION (24)", [&]() {
+        return Message(sender, MSG_TYPE_GPS_POSITION, sizeof(gps), &gps); });
+    bench("TEXT short (13)", [&]() {
+        return Message::TextMessage(sender, short_text); });
+    bench("SYSTEM short (24)", [&]() {
+        return Message::SystemMessage(sender, 0, MSG_LEVEL_MILESTONE, short_text); });
+    bench("TELEMETRY (29)", [&]() {
+        return Message::TelemetryMessage(sender, 0, "GPS_LAT", "48.1234567"); });
+    bench("SYSTEM long (80)", [&]() {
+        return Message::SystemMessage(sender, 0, MSG_LEVEL_STATUSREPORT, long_text); });
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+    The binary codec of messages (Message::buffer() and the constructor from buffer)
+    must reproduce every message type exactly and reject damaged frames.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "kernel.h"
+#include "message.h"
+#include "telemetry.h"
+#include "types.h"
+#include "util.h"
+#include "check.h"
+
+#define FRAME_SIZE 255
+
+// encode, decode and encode again - both frames must be identical
+static Message round_trip(Message msg, size_t size = FRAME_SIZE)
+{
+    char frame[FRAME_SIZE];
+    char again[FRAME_SIZE];
+    uint8_t n = msg.buffer(frame, size);
+    CHECK(n > 0);
+    Message decoded(frame, n);
+    CHECK_EQ(decoded.type(), msg.type());
+    CHECK(strcmp(decoded.sender_name(), msg.sender_name()) == 0);
+    CHECK_EQ(decoded.buffer(again, FRAME_SIZE), n);
+    CHECK(memcmp(frame, again, n) == 0);
+    return decoded;
+}
+
+// the data blob must be reproduced byte by byte (for blobs without padding)
+static void check_exact(Message msg)
+{
+    Message decoded = round_trip(msg);
+    CHECK_EQ(decoded.size(), msg.size());
+    if (msg.size() > 0)
+        CHECK(memcmp(decoded.data(), msg.data(), msg.size()) == 0);
+}
+
+static void test_text_types()
+{
+    Message sys = round_trip(Message::SystemMessage("SYSTEM", 123456, MSG_LEVEL_CRITICAL, "file opened."));
+    CHECK(sys.printout() == Message::SystemMessage("SYSTEM", 123456, MSG_LEVEL_CRITICAL, "file opened.").printout());
+    CHECK_EQ(sys.size(), sizeof(MSG_DATA_SYSTEM) + 12);
+    Message text = round_trip(Message::TextMessage("LOGGER", "a text message which does not fit into the message itself"));
+    CHECK(text.printout() == "LOGGER   : a text message which does not fit into the message itself");
+    Message empty = round_trip(Message::TextMessage("LOGGER", ""));
+    CHECK_EQ(empty.size(), sizeof(MSG_DATA_TEXT));
+    Message tm = round_trip(Message::TelemetryMessage("GPS_1", 5000, "GPS_LAT", "48.123456"));
+    CHECK(tm.printout() == Message::TelemetryMessage("GPS_1", 5000, "GPS_LAT", "48.123456").printout());
+    // formatting into a buffer gives the same text, truncated if necessary
+    char line[MSG_MAX_PRINTOUT+1];
+    CHECK_EQ(tm.printout(line, sizeof(line)), tm.printout().size());
+    CHECK(tm.printout() == line);
+    CHECK_EQ(tm.printout(line, 12), 11);
+    CHECK(strcmp(line, "GPS_1    : ") == 0);
+    Message longest = Message::TelemetryMessage("GPS_1", 5000, std::string(300, 'v'), std::string(300, 'x'));
+    CHECK_EQ(longest.printout(line, sizeof(line)), 8+3+10+3+255+3+255);
+}
+
+static void test_binary_types()
+{
+    MSG_DATA_GPS_POSITION gps;
+    memset(&gps, 0, sizeof(gps));
+    gps.latitude = 48.1234567;
+    gps.longitude = -11.7654321;
+    gps.altitude = 520.25;
+    check_exact(Message("GPS_1", MSG_TYPE_GPS_POSITION, sizeof(gps), &gps));
+    MSG_DATA_SERVO servo = { { 1000, -2000, 3000, -4000, 5000, -6000, 7000, -8000 } };
+    check_exact(Message("SERVO_1", MSG_TYPE_SERVO, sizeof(servo), &servo));
+    char command[] = { 0x01, 0x02, 0x00, (char)0xFF, 0x7F };
+    check_exact(Message("UPLINK", MSG_TYPE_COMMAND, sizeof(command), command));
+    check_exact(Message("MODEM_1", MSG_TYPE_PING, 0, NULL));
+    check_exact(Message("MODEM_1", MSG_TYPE_PINGRESPONSE, 3, command));
+    DATA_IMU_AHRS ahrs = { 1.5, 270.0, -3.25 };
+    check_exact(Message("IMU_1", MSG_TYPE_IMU_AHRS, sizeof(ahrs), &ahrs));
+    DATA_IMU_GYRO gyro = { 0.125, -0.5, 100.0 };
+    check_exact(Message("IMU_1", MSG_TYPE_IMU_GYRO, sizeof(gyro), &gyro));
+    // the data messages : hash and timestamp followed by the values
+    // the sender is restored from the hash of a declared variable
+    uint16_t hash;
+    CHECK(FC_telemetry_declare(FC_name_handle("IMU_1"), "ACC_X", &hash));
+    uint8_t data[6+5*8];
+    for (size_t i=0; i<sizeof(data); i++) data[i] = 17*i;
+    memcpy(data, &hash, 2);
+    check_exact(Message("IMU_1", MSG_TYPE_DATA_INT16, 6+5*2, data));
+    check_exact(Message("IMU_1", MSG_TYPE_DATA_FLOAT, 6+5*4, data));
+    check_exact(Message("IMU_1", MSG_TYPE_DATA_DOUBLE, 6+5*8, data));
+    check_exact(Message("IMU_1", MSG_TYPE_DATA_DOUBLE, 6, data));
+    check_exact(Message("IMU_1", MSG_TYPE_DATA_GPS, 26, data));
+}
+
+static void test_telemetry()
+{
+    char frame[FRAME_SIZE];
+    uint16_t gps = FC_name_handle("GPS_1");
+    // the declaration carries the sender and the variable name
+    uint16_t hash;
+    CHECK(FC_telemetry_declare(gps, "GPS_POS", &hash));
+    CHECK_EQ(hash, FC_telemetry_hash(gps, "GPS_POS"));
+    Message decl = round_trip(Message::TelemetryVariable(gps, hash, "GPS_POS"));
+    CHECK(decl.printout().find("GPS_POS") != std::string::npos);
+    // declaring the same variable again gives the same hash
+    uint16_t again;
+    CHECK(FC_telemetry_declare(gps, "GPS_POS", &again));
+    CHECK_EQ(again, hash);
+    // a sample takes type, length, hash, time, value and CRC
+    Message sample = Message::DataMessage(gps, hash, 5000, 1.5f);
+    CHECK_EQ(sample.buffer(frame, FRAME_SIZE), 3+2+4+4+2);
+    CHECK_EQ(Message(frame).sender(), gps);
+    MSG_DATA_GPS_POSITION pos = { 48.1234567, -11.7654321, 520.25 };
+    Message position = round_trip(Message::DataMessage(gps, hash, 5000, pos));
+    CHECK_EQ(position.size(), 26);
+    CHECK(position.printout() ==
+        "GPS_1    :      5.000 : GPS_POS  : lat= 48.123457, long= -11.765432, alti= 520.25");
+    // a sample of an unknown variable has no sender
+    Message unknown = Message::DataMessage(gps, hash+1, 5000, (int16_t)-7);
+    unknown.buffer(frame, FRAME_SIZE);
+    Message decoded(frame);
+    CHECK_EQ(decoded.type(), MSG_TYPE_DATA_INT16);
+    CHECK_EQ(decoded.sender(), NAME_HANDLE_NONE);
+    char name[8];
+    snprintf(name, sizeof(name), "#%04X", (uint16_t)(hash+1));
+    CHECK(decoded.print_content().find(name) != std::string::npos);
+    // a declaration received from a remote system is registered
+    uint8_t blob[sizeof(MSG_TELEMETRY_VARIABLE) + 4];
+    MSG_TELEMETRY_VARIABLE* var = (MSG_TELEMETRY_VARIABLE*)blob;
+    var->hash = 0x1234;
+    var->variable = 4;
+    memcpy(var+1, "BARO", 4);
+    Message remote("REMOTE", MSG_TYPE_TELEMETRY_VARIABLE, sizeof(blob), blob);
+    remote.buffer(frame, FRAME_SIZE);
+    CHECK(FC_telemetry_lookup(0x1234) == 0);
+    Message received(frame);
+    CHECK_EQ(received.type(), MSG_TYPE_TELEMETRY_VARIABLE);
+    const TelemetryEntry* known = FC_telemetry_lookup(0x1234);
+    CHECK(known != 0);
+    CHECK_EQ(known->sender, FC_name_handle("REMOTE"));
+    CHECK(strcmp(known->name, "BARO") == 0);
+    // another variable colliding with a registered hash cannot be declared
+    CHECK(!FC_telemetry_register(hash, gps, "GPS_VEL"));
+    // a hash of 0 is as good as any other
+    CHECK(FC_telemetry_register(0, gps, "GPS_ALT"));
+    CHECK(FC_telemetry_lookup(0) != 0);
+    CHECK(strcmp(FC_telemetry_lookup(0)->name, "GPS_ALT") == 0);
+}
+
+static void test_layout_mismatch()
+{
+    char frame[FRAME_SIZE];
+    uint8_t data[32];
+    memset(data, 0, sizeof(data));
+    // the size of the data blob does not match the layout of the type
+    CHECK_EQ(Message("GPS_1", MSG_TYPE_GPS_POSITION, 20, data).buffer(frame, FRAME_SIZE), 0);
+    CHECK_EQ(Message("IMU_1", MSG_TYPE_DATA_FLOAT, 6+6, data).buffer(frame, FRAME_SIZE), 0);
+    CHECK_EQ(Message("IMU_1", MSG_TYPE_DATA_INT16, 2, data).buffer(frame, FRAME_SIZE), 0);
+    // unknown type
+    CHECK_EQ(Message("IMU_1", 0x1234, 4, data).buffer(frame, FRAME_SIZE), 0);
+    // buffer too small for a message not ending with a text
+    MSG_DATA_SERVO servo = { { 1, 2, 3, 4, 5, 6, 7, 8 } };
+    CHECK_EQ(Message("SERVO_1", MSG_TYPE_SERVO, sizeof(servo), &servo).buffer(frame, 20), 0);
+    CHECK_EQ(Message("MODEM_1", MSG_TYPE_PING, 0, NULL).buffer(frame, 12), 0);
+}
+
+static void test_truncation()
+{
+    std::string text(300, 'x');
+    Message msg = Message::SystemMessage("SYSTEM", 1000, MSG_LEVEL_STATUSREPORT, text);
+    char frame[FRAME_SIZE];
+    // the text is truncated to fit the buffer
+    uint8_t n = msg.buffer(frame, 40);
+    CHECK_EQ(n, 40);
+    Message decoded(frame, n);
+    CHECK_EQ(decoded.type(), MSG_TYPE_SYSTEM);
+    CHECK_EQ(decoded.size(), sizeof(MSG_DATA_SYSTEM) + 40-11-2-6);
+    // and to the largest possible frame
+    n = msg.buffer(frame, FRAME_SIZE);
+    CHECK_EQ(n, 255);
+    CHECK_EQ(Message(frame, n).type(), MSG_TYPE_SYSTEM);
+}
+
+// a frame that is not valid gives an empty message
+static bool rejected(const char* frame, size_t size)
+{
+    Message msg(frame, size);
+    return (msg.type() == MSG_TYPE_ABSTRACT) and (msg.sender() == NAME_HANDLE_NONE)
+        and (msg.size() == 0);
+}
+
+static void test_damaged_frames()
+{
+    char frame[FRAME_SIZE];
+    Message msg = Message::TelemetryMessage("GPS_1", 5000, "GPS_LAT", "48.123456");
+    uint8_t n = msg.buffer(frame, FRAME_SIZE);
+    CHECK(!rejected(frame, n));
+    // every single damaged byte is detected by the CRC
+    int missed = 0;
+    for (int i=0; i<n; i++)
+        for (int bit=0; bit<8; bit++)
+        {
+            frame[i] ^= (1<<bit);
+            if (!rejected(frame, n)) missed++;
+            frame[i] ^= (1<<bit);
+        };
+    CHECK_EQ(missed, 0);
+    // incomplete frames
+    for (int size=0; size<n; size++)
+        CHECK(rejected(frame, size));
+    // a frame with a valid CRC but a wrong text length
+    frame[11+4] += 1;
+    uint16_t crc = crc16((const uint8_t*)frame, n-2);
+    frame[n-2] = crc >> 8;
+    frame[n-1] = crc & 0xFF;
+    CHECK(rejected(frame, n));
+}
+
+int main()
+{
+    test_text_types();
+    test_binary_types();
+    test_telemetry();
+    test_layout_mismatch();
+    test_truncation();
+    test_damaged_frames();
+    return check_result("message_codec");
+}
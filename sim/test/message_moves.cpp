@@ -0,0 +1,168 @@
+/*
+    Messages passed along a single-receiver path must not be copied.
+    We count the heap allocations (global operator new) and the data blobs
+    taken from the message pool while messages are transmitted and fetched.
+*/
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#include "message.h"
+#include "pool.h"
+#include "port.h"
+#include "check.h"
+
+// count all heap allocations of the program
+static long heap_allocations = 0;
+
+void* operator new(size_t size)
+{
+    heap_allocations++;
+    void *p = malloc(size);
+    if (p == 0) abort();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// the number of data blobs currently taken from the pool
+static int pool_blocks()
+{
+    int n = 0;
+    for (int i=0; i<POOL_NUM_CLASSES; i++) n += FC_pool_in_use(i);
+    return n;
+}
+
+// the sender of all test messages
+#define SENDER "TEST"
+
+// a text too long to be kept inside the message, it is allocated from the pool
+#define TEXT "a text message which does not fit into the message itself"
+
+static void test_single_receiver()
+{
+    SenderPort out;
+    ReceiverPort in;
+    out.set_receiver(&in);
+    Message msg = Message::TextMessage(SENDER, TEXT);
+    CHECK_EQ(pool_blocks(), 1);
+    const void *data = msg.data();
+    // moving into the port only allocates the list node of the queue
+    long before = heap_allocations;
+    out.transmit(std::move(msg));
+    CHECK_EQ(heap_allocations - before, 1);
+    CHECK(msg.data() == NULL);
+    CHECK_EQ(in.count(), 1);
+    CHECK_EQ(pool_blocks(), 1);
+    // fetching moves the message out of the queue
+    before = heap_allocations;
+    Message received = in.fetch();
+    CHECK_EQ(heap_allocations - before, 0);
+    CHECK(received.data() == data);
+    CHECK(!received.shared());
+    CHECK_EQ(pool_blocks(), 1);
+}
+
+static void test_temporary()
+{
+    SenderPort out;
+    ReceiverPort in;
+    out.set_receiver(&in);
+    out.transmit(Message::TextMessage(SENDER, TEXT));
+    CHECK_EQ(pool_blocks(), 1);
+    Message received = in.fetch();
+    CHECK(!received.shared());
+    CHECK_EQ(pool_blocks(), 1);
+}
+
+static void test_fan_out()
+{
+    SenderPort out;
+    ReceiverPort in[3];
+    for (int i=0; i<3; i++) out.set_receiver(&in[i]);
+    Message msg = Message::TextMessage(SENDER, TEXT);
+    const void *data = msg.data();
+    out.transmit(std::move(msg));
+    // all receivers share the same data blob
+    CHECK_EQ(pool_blocks(), 1);
+    for (int i=0; i<3; i++)
+    {
+        Message received = in[i].fetch();
+        CHECK(received.data() == data);
+    };
+    CHECK_EQ(pool_blocks(), 0);
+}
+
+static void test_copy()
+{
+    SenderPort out;
+    ReceiverPort in;
+    out.set_receiver(&in);
+    Message msg = Message::TextMessage(SENDER, TEXT);
+    // an lvalue is copied, the data are shared
+    out.transmit(msg);
+    CHECK(msg.data() != NULL);
+    CHECK(msg.shared());
+    CHECK_EQ(pool_blocks(), 1);
+    Message received = in.fetch();
+    CHECK(received.data() == msg.data());
+    // a modification makes a private copy
+    ((char*)received.get_data())[0] = 0;
+    CHECK(received.data() != msg.data());
+    CHECK(!msg.shared());
+    CHECK_EQ(pool_blocks(), 2);
+}
+
+static void test_move_assignment()
+{
+    Message a = Message::TextMessage(SENDER, TEXT);
+    Message b = Message::TextMessage(SENDER, TEXT);
+    const void *data = b.data();
+    CHECK_EQ(pool_blocks(), 2);
+    long before = heap_allocations;
+    a = std::move(b);
+    CHECK_EQ(heap_allocations - before, 0);
+    CHECK(a.data() == data);
+    CHECK(b.data() == NULL);
+    CHECK_EQ(pool_blocks(), 1);
+}
+
+static void test_inline()
+{
+    SenderPort out;
+    ReceiverPort in[2];
+    out.set_receiver(&in[0]);
+    out.set_receiver(&in[1]);
+    // small data are not allocated at all
+    long before = heap_allocations;
+    Message msg = Message::TextMessage(SENDER, "short");
+    CHECK(msg.size() <= MESSAGE_INLINE_SIZE);
+    CHECK_EQ(pool_blocks(), 0);
+    CHECK_EQ(heap_allocations - before, 0);
+    // every copy has its own data
+    out.transmit(msg);
+    CHECK(!msg.shared());
+    Message received = in[0].fetch();
+    ((char*)received.get_data())[sizeof(MSG_DATA_TEXT)] = 'S';
+    CHECK(received.printout() != msg.printout());
+    CHECK(in[1].fetch().printout() == msg.printout());
+    CHECK_EQ(pool_blocks(), 0);
+}
+
+int main()
+{
+    test_single_receiver();
+    CHECK_EQ(pool_blocks(), 0);
+    test_temporary();
+    CHECK_EQ(pool_blocks(), 0);
+    test_fan_out();
+    CHECK_EQ(pool_blocks(), 0);
+    test_copy();
+    CHECK_EQ(pool_blocks(), 0);
+    test_move_assignment();
+    CHECK_EQ(pool_blocks(), 0);
+    test_inline();
+    return check_result("message_moves");
+}
@@ -0,0 +1,164 @@
+/*
+    The overflow policies of receiver ports with a bounded queue.
+*/
+
+#include <utility>
+
+#include "message.h"
+#include "pool.h"
+#include "port.h"
+#include "check.h"
+
+// a message carrying a number
+static Message numbered(uint16_t n)
+{
+    return Message("TEST", MSG_TYPE_ABSTRACT, sizeof(n), &n);
+}
+
+static uint16_t number(Message msg)
+{
+    return *(const uint16_t*)msg.data();
+}
+
+static void test_unbounded()
+{
+    ReceiverPort in;
+    for (uint16_t i=0; i<100; i++)
+        CHECK(in.receive(numbered(i)));
+    CHECK_EQ(in.count(), 100);
+    CHECK_EQ(in.high_water(), 100);
+    CHECK_EQ(in.dropped(), 0);
+    for (uint16_t i=0; i<100; i++)
+        CHECK_EQ(number(in.fetch()), i);
+}
+
+static void test_drop_newest()
+{
+    SenderPort out;
+    ReceiverPort in;
+    in.set_capacity(4, PORT_OVERFLOW_DROP_NEWEST);
+    out.set_receiver(&in);
+    // the sender is not told about dropped messages
+    for (uint16_t i=0; i<10; i++)
+        CHECK(out.transmit(numbered(i)));
+    CHECK_EQ(in.count(), 4);
+    CHECK_EQ(in.dropped(), 6);
+    CHECK_EQ(in.high_water(), 4);
+    for (uint16_t i=0; i<4; i++)
+        CHECK_EQ(number(in.fetch()), i);
+    CHECK_EQ(in.count(), 0);
+}
+
+static void test_drop_oldest()
+{
+    ReceiverPort in;
+    in.set_capacity(4, PORT_OVERFLOW_DROP_OLDEST);
+    for (uint16_t i=0; i<10; i++)
+        CHECK(in.receive(numbered(i)));
+    CHECK_EQ(in.count(), 4);
+    CHECK_EQ(in.dropped(), 6);
+    for (uint16_t i=6; i<10; i++)
+        CHECK_EQ(number(in.fetch()), i);
+    // the ring wraps around
+    for (uint16_t k=0; k<3; k++)
+    {
+        for (uint16_t i=0; i<3; i++) in.receive(numbered(10*k+i));
+        for (uint16_t i=0; i<3; i++) CHECK_EQ(number(in.fetch()), 10*k+i);
+    };
+    CHECK_EQ(in.dropped(), 6);
+}
+
+static void test_reject()
+{
+    SenderPort out;
+    ReceiverPort accepting, rejecting;
+    rejecting.set_capacity(2, PORT_OVERFLOW_REJECT);
+    out.set_receiver(&rejecting);
+    out.set_receiver(&accepting);
+    CHECK(out.transmit(numbered(1)));
+    CHECK(out.transmit(numbered(2)));
+    // the sender sees the rejection, the other receiver still gets the message
+    CHECK(!out.transmit(numbered(3)));
+    CHECK_EQ(rejecting.count(), 2);
+    CHECK_EQ(rejecting.dropped(), 1);
+    CHECK_EQ(accepting.count(), 3);
+    rejecting.fetch();
+    CHECK(out.transmit(numbered(4)));
+    CHECK_EQ(number(rejecting.fetch()), 2);
+    CHECK_EQ(number(rejecting.fetch()), 4);
+}
+
+static void test_set_capacity()
+{
+    ReceiverPort in;
+    for (uint16_t i=0; i<6; i++) in.receive(numbered(i));
+    // the waiting messages are kept as far as they fit
+    in.set_capacity(4, PORT_OVERFLOW_DROP_OLDEST);
+    CHECK_EQ(in.count(), 4);
+    CHECK_EQ(in.dropped(), 2);
+    CHECK_EQ(number(in.fetch()), 2);
+    in.reset_high_water();
+    CHECK_EQ(in.high_water(), 3);
+}
+
+static int pool_blocks()
+{
+    int n = 0;
+    for (int i=0; i<POOL_NUM_CLASSES; i++) n += FC_pool_in_use(i);
+    return n;
+}
+
+static void test_peek_consume()
+{
+    // the ring gives blocks up to its end
+    ReceiverPort in;
+    in.set_capacity(8, PORT_OVERFLOW_DROP_NEWEST);
+    for (uint16_t i=0; i<6; i++) in.receive(numbered(i));
+    in.consume(4);
+    for (uint16_t i=6; i<10; i++) in.receive(numbered(i));
+    uint16_t n;
+    Message *msg = in.peek(&n);
+    CHECK_EQ(n, 4);
+    CHECK_EQ(number(msg[0]), 4);
+    CHECK_EQ(number(msg[3]), 7);
+    in.consume(n);
+    msg = in.peek(&n);
+    CHECK_EQ(n, 2);
+    CHECK_EQ(number(msg[1]), 9);
+    in.consume(n);
+    in.peek(&n);
+    CHECK_EQ(n, 0);
+    CHECK_EQ(in.count(), 0);
+    // an unbounded queue gives one message at a time
+    ReceiverPort list;
+    CHECK(list.peek(&n) == 0);
+    CHECK_EQ(n, 0);
+    for (uint16_t i=0; i<3; i++) list.receive(numbered(i));
+    CHECK_EQ(number(*list.peek(&n)), 0);
+    CHECK_EQ(n, 1);
+    list.consume(2);
+    CHECK_EQ(number(*list.peek(&n)), 2);
+    list.consume(5);
+    CHECK_EQ(list.count(), 0);
+}
+
+int main()
+{
+    test_unbounded();
+    test_drop_newest();
+    test_drop_oldest();
+    test_reject();
+    test_set_capacity();
+    test_peek_consume();
+    {
+        // messages left in the ring are released with the port
+        ReceiverPort in;
+        in.set_capacity(8, PORT_OVERFLOW_DROP_OLDEST);
+        char data[MESSAGE_INLINE_SIZE+1];
+        for (uint16_t i=0; i<20; i++)
+            in.receive(Message("TEST", MSG_TYPE_ABSTRACT, sizeof(data), data));
+        CHECK_EQ(pool_blocks(), 8);
+    }
+    CHECK_EQ(pool_blocks(), 0);
+    return check_result("port_overflow");
+}
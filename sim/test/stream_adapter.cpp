@@ -0,0 +1,118 @@
+/*
+    The stream adapters reducing the rate of a stream.
+*/
+
+#include "stream.h"
+#include "types.h"
+#include "check.h"
+
+static DATA_IMU_GYRO sample(float nick, float yaw, float roll)
+{
+    DATA_IMU_GYRO data = { nick, yaw, roll };
+    return data;
+}
+
+// send the values 1 ... 12 through an adapter, the output is collected
+// (the data are stamped with 100 times their value)
+static void run(StreamAdapter<DATA_IMU_GYRO>& adapter, StreamReceiver<DATA_IMU_GYRO>& in)
+{
+    StreamSender<DATA_IMU_GYRO> out;
+    out.set_receiver(&adapter);
+    adapter.out.set_receiver(&in);
+    for (int i=1; i<=12; i++)
+        out.transmit(sample(i, -i, (i % 2) ? 10.0f : -10.0f), 100*i);
+}
+
+static void test_decimate()
+{
+    StreamAdapter<DATA_IMU_GYRO> adapter(STREAM_ADAPTER_DECIMATE, 4);
+    StreamReceiver<DATA_IMU_GYRO> in;
+    run(adapter, in);
+    CHECK_EQ(in.count(), 3);
+    StreamSample<DATA_IMU_GYRO> s = in.fetch_sample();
+    CHECK_EQ(s.data.nick, 4.0f);
+    CHECK_EQ(s.cycles, 400);
+    CHECK_EQ(in.fetch().nick, 8.0f);
+    CHECK_EQ(in.fetch().yaw, -12.0f);
+}
+
+static void test_average()
+{
+    StreamAdapter<DATA_IMU_GYRO> adapter(STREAM_ADAPTER_AVERAGE, 4);
+    StreamReceiver<DATA_IMU_GYRO> in;
+    run(adapter, in);
+    CHECK_EQ(in.count(), 3);
+    DATA_IMU_GYRO data = in.fetch();
+    CHECK_EQ(data.nick, 2.5f);
+    CHECK_EQ(data.yaw, -2.5f);
+    CHECK_EQ(data.roll, 0.0f);
+    // the average is stamped with the middle of the window
+    StreamSample<DATA_IMU_GYRO> s = in.fetch_sample();
+    CHECK_EQ(s.data.nick, 6.5f);
+    CHECK_EQ(s.cycles, 650);
+    CHECK_EQ(in.fetch().nick, 10.5f);
+}
+
+static void test_exponential()
+{
+    // every data block is passed on
+    StreamAdapter<DATA_IMU_GYRO> adapter(STREAM_ADAPTER_EXPONENTIAL, 1, 0.5);
+    StreamReceiver<DATA_IMU_GYRO> in;
+    run(adapter, in);
+    CHECK_EQ(in.count(), 12);
+    CHECK_EQ(in.fetch().nick, 1.0f);
+    CHECK_EQ(in.fetch().nick, 1.5f);
+    CHECK_EQ(in.fetch().nick, 2.25f);
+    // the average follows with a lag of 1/alpha - 1
+    float last = 0.0;
+    while (in.count() > 0) last = in.fetch().nick;
+    CHECK((last > 10.9f) and (last < 11.1f));
+}
+
+static void test_min_max()
+{
+    StreamAdapter<DATA_IMU_GYRO> minimum(STREAM_ADAPTER_MINIMUM, 6);
+    StreamReceiver<DATA_IMU_GYRO> low;
+    run(minimum, low);
+    CHECK_EQ(low.count(), 2);
+    DATA_IMU_GYRO data = low.fetch();
+    CHECK_EQ(data.nick, 1.0f);
+    CHECK_EQ(data.yaw, -6.0f);
+    CHECK_EQ(data.roll, -10.0f);
+    CHECK_EQ(low.fetch().nick, 7.0f);
+    StreamAdapter<DATA_IMU_GYRO> maximum(STREAM_ADAPTER_MAXIMUM, 6);
+    StreamReceiver<DATA_IMU_GYRO> high;
+    run(maximum, high);
+    data = high.fetch();
+    CHECK_EQ(data.nick, 6.0f);
+    CHECK_EQ(data.yaw, -1.0f);
+    CHECK_EQ(data.roll, 10.0f);
+    CHECK_EQ(high.fetch().nick, 12.0f);
+}
+
+static void test_chain()
+{
+    // average by 2, then maximum by 3
+    StreamAdapter<DATA_IMU_GYRO> average(STREAM_ADAPTER_AVERAGE, 2);
+    StreamAdapter<DATA_IMU_GYRO> maximum(STREAM_ADAPTER_MAXIMUM, 3);
+    StreamReceiver<DATA_IMU_GYRO> in;
+    average.out.set_receiver(&maximum);
+    maximum.out.set_receiver(&in);
+    StreamSender<DATA_IMU_GYRO> out;
+    out.set_receiver(&average);
+    for (int i=1; i<=12; i++) out.transmit(sample(i, 0, 0));
+    // (1.5 3.5 5.5) (7.5 9.5 11.5)
+    CHECK_EQ(in.count(), 2);
+    CHECK_EQ(in.fetch().nick, 5.5f);
+    CHECK_EQ(in.fetch().nick, 11.5f);
+}
+
+int main()
+{
+    test_decimate();
+    test_average();
+    test_exponential();
+    test_min_max();
+    test_chain();
+    return check_result("stream_adapter");
+}
@@ -0,0 +1,113 @@
+/*
+    Throughput of stream receivers.
+
+    DATA_IMU_GYRO samples are passed through a StreamReceiver in bursts
+    of a given size (the sender stores the burst, the receiver fetches all of it).
+    For comparison the same is done with the former implementation
+    keeping the samples in a std::list (one heap node per sample).
+    The burst is also fetched at once with fetch_n() and peek()/consume().
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <list>
+
+#include "stream.h"
+#include "types.h"
+
+#define SAMPLES 10000000
+
+// keep the compiler from optimizing the work away
+static volatile float sink;
+
+// the former stream receiver without the scheduling of the owner
+template <typename datatype>
+class ListStreamReceiver {
+    public:
+        void receive(datatype data, uint64_t cycles) { queue.push_back(data); };
+        uint16_t count() { return queue.size(); };
+        datatype fetch()
+        {
+            datatype data = queue.front();
+            queue.pop_front();
+            return data;
+        };
+    protected:
+        std::list<datatype> queue;
+};
+
+// the ways to get the data out of the receiver
+#define FETCH_SINGLE    0
+#define FETCH_N         1
+#define FETCH_PEEK      2
+
+static float drain(StreamReceiver<DATA_IMU_GYRO>& in, int mode)
+{
+    float sum = 0.0;
+    if (mode == FETCH_N)
+    {
+        DATA_IMU_GYRO out[64];
+        uint16_t n = in.fetch_n(out, 64);
+        for (uint16_t i=0; i<n; i++) sum += out[i].nick;
+    }
+    else if (mode == FETCH_PEEK)
+    {
+        uint16_t n;
+        while (in.count() > 0)
+        {
+            const StreamSample<DATA_IMU_GYRO> *data = in.peek(&n);
+            for (uint16_t i=0; i<n; i++) sum += data[i].data.nick;
+            in.consume(n);
+        };
+    }
+    else
+        while (in.count() > 0) sum += in.fetch().nick;
+    return sum;
+}
+
+static float drain(ListStreamReceiver<DATA_IMU_GYRO>& in, int mode)
+{
+    float sum = 0.0;
+    while (in.count() > 0) sum += in.fetch().nick;
+    return sum;
+}
+
+template<typename R>
+static double bench(R& in, int burst, int mode = FETCH_SINGLE)
+{
+    DATA_IMU_GYRO data = { 1.0, 2.0, 3.0 };
+    float sum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i=0; i<SAMPLES; i+=burst)
+    {
+        for (int k=0; k<burst; k++)
+        {
+            data.nick = k;
+            in.receive(data, i+k);
+        };
+        sum += drain(in, mode);
+    };
+    sink = sum;
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / SAMPLES;
+}
+
+int main()
+{
+    printf("stream of DATA_IMU_GYRO (%d bytes), %d samples\n",
+        (int)sizeof(DATA_IMU_GYRO), SAMPLES);
+    printf("  burst      ring  fetch_n     peek     list  (ns per sample)\n");
+    int bursts[] = { 1, 8, 50 };
+    for (int burst : bursts)
+    {
+        StreamReceiver<DATA_IMU_GYRO> ring;
+        ring.set_capacity(64);
+        ListStreamReceiver<DATA_IMU_GYRO> list;
+        double t_ring = bench(ring, burst);
+        double t_fetch_n = bench(ring, burst, FETCH_N);
+        double t_peek = bench(ring, burst, FETCH_PEEK);
+        double t_list = bench(list, burst);
+        printf("  %5d  %8.2f %8.2f %8.2f %8.2f\n", burst, t_ring, t_fetch_n, t_peek, t_list);
+    };
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+    The mailbox stream receiver keeps only the latest data block
+    and never delivers a mix of two data blocks.
+*/
+
+#include <atomic>
+#include <thread>
+
+#include "stream.h"
+#include "types.h"
+#include "check.h"
+
+static DATA_IMU_AHRS sample(uint32_t n)
+{
+    DATA_IMU_AHRS data = { (float)n, 2.0f*n, -(float)n };
+    return data;
+}
+
+static void test_latest()
+{
+    StreamSender<DATA_IMU_AHRS> out;
+    StreamMailbox<DATA_IMU_AHRS> mailbox;
+    StreamReceiver<DATA_IMU_AHRS> queue;
+    // a mailbox and a queue are wired to the same sender
+    out.set_receiver(&mailbox);
+    out.set_receiver(&queue);
+    DATA_IMU_AHRS data = sample(99);
+    CHECK_EQ(mailbox.sequence(), 0);
+    CHECK_EQ(mailbox.read(&data), 0);
+    CHECK_EQ(data.attitude, 99.0f);
+    for (uint32_t i=1; i<=10; i++) out.transmit(sample(i), 1000+i);
+    CHECK_EQ(mailbox.sequence(), 10);
+    uint64_t cycles = 0;
+    CHECK_EQ(mailbox.read(&data, &cycles), 10);
+    CHECK_EQ(data.attitude, 10.0f);
+    CHECK_EQ(cycles, 1010);
+    CHECK_EQ(data.roll, -10.0f);
+    // reading does not consume the data
+    CHECK_EQ(mailbox.read(&data), 10);
+    CHECK_EQ(queue.count(), 10);
+}
+
+// the sender runs in its own thread like an interrupt would
+static void test_tear_free()
+{
+    const uint32_t N = 1000000;
+    StreamMailbox<DATA_IMU_AHRS> mailbox;
+    std::atomic<bool> done(false);
+    std::thread producer([&]() {
+        for (uint32_t i=1; i<=N; i++) mailbox.receive(sample(i), (uint64_t)i << 32 | i);
+        done = true;
+    });
+    uint32_t reads = 0;
+    uint32_t torn = 0;
+    uint32_t backwards = 0;
+    uint32_t last = 0;
+    while (!done)
+    {
+        DATA_IMU_AHRS data;
+        uint64_t cycles;
+        uint32_t seq = mailbox.read(&data, &cycles);
+        if (seq == 0) continue;
+        if ((data.heading != 2.0f*data.attitude) or (data.roll != -data.attitude)
+            or (data.attitude != (float)seq)) torn++;
+        if (cycles != ((uint64_t)seq << 32 | seq)) torn++;
+        if (seq < last) backwards++;
+        last = seq;
+        reads++;
+    };
+    producer.join();
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(backwards, 0);
+    CHECK(reads > 0);
+    CHECK_EQ(mailbox.sequence(), N);
+}
+
+int main()
+{
+    test_latest();
+    test_tear_free();
+    return check_result("stream_mailbox");
+}
@@ -0,0 +1,154 @@
+/*
+    The ring buffer of stream receivers : capacity, order of the data blocks,
+    timestamps, overruns and a sender and receiver running concurrently.
+*/
+
+#include <thread>
+
+#include "stream.h"
+#include "types.h"
+#include "check.h"
+
+static DATA_IMU_GYRO sample(uint32_t n)
+{
+    DATA_IMU_GYRO data = { (float)n, -(float)n, 0.5f };
+    return data;
+}
+
+static void test_capacity()
+{
+    StreamReceiver<DATA_IMU_GYRO> in;
+    CHECK_EQ(in.capacity(), STREAM_DEFAULT_CAPACITY);
+    in.set_capacity(100);
+    CHECK_EQ(in.capacity(), 128);
+    in.set_capacity(64);
+    CHECK_EQ(in.capacity(), 64);
+    in.set_capacity(40000);
+    CHECK_EQ(in.capacity(), 32768);
+}
+
+static void test_order()
+{
+    StreamSender<DATA_IMU_GYRO> out;
+    StreamReceiver<DATA_IMU_GYRO> in;
+    in.set_capacity(8);
+    out.set_receiver(&in);
+    // the indices wrap around the buffer many times
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    for (int round=0; round<100; round++)
+    {
+        for (int i=0; i<5; i++) out.transmit(sample(sent++));
+        CHECK_EQ(in.count(), sent - received);
+        while (in.count() > 0)
+            CHECK_EQ(in.fetch().nick, (float)received++);
+    };
+    CHECK_EQ(received, 500);
+    CHECK_EQ(in.overruns(), 0);
+}
+
+static void test_timestamps()
+{
+    StreamSender<DATA_IMU_GYRO> out;
+    StreamReceiver<DATA_IMU_GYRO> in;
+    out.set_receiver(&in);
+    // the time of the measurement is passed on
+    uint64_t measured = 0x123456789abcULL;
+    out.transmit(sample(1), measured);
+    // without it the data are stamped when they are sent
+    uint64_t before = FC_cycle_count();
+    out.transmit(sample(2));
+    uint64_t after = FC_cycle_count();
+    StreamSample<DATA_IMU_GYRO> s = in.fetch_sample();
+    CHECK_EQ(s.cycles, measured);
+    CHECK_EQ(s.data.nick, 1.0f);
+    s = in.fetch_sample();
+    CHECK((s.cycles >= before) and (s.cycles <= after));
+    CHECK_EQ(s.data.nick, 2.0f);
+}
+
+static void test_overrun()
+{
+    StreamReceiver<DATA_IMU_GYRO> in;
+    in.set_capacity(4);
+    for (uint32_t i=0; i<10; i++) in.receive(sample(i), i);
+    // the newest data blocks are dropped
+    CHECK_EQ(in.count(), 4);
+    CHECK_EQ(in.overruns(), 6);
+    for (uint32_t i=0; i<4; i++)
+        CHECK_EQ(in.fetch().nick, (float)i);
+    in.receive(sample(10), 10);
+    CHECK_EQ(in.count(), 1);
+    CHECK_EQ(in.fetch().nick, 10.0f);
+    in.reset_overruns();
+    CHECK_EQ(in.overruns(), 0);
+}
+
+static void test_batches()
+{
+    StreamReceiver<DATA_IMU_GYRO> in;
+    in.set_capacity(8);
+    DATA_IMU_GYRO out[8];
+    for (uint32_t i=0; i<5; i++) in.receive(sample(i), i);
+    CHECK_EQ(in.fetch_n(out, 3), 3);
+    CHECK_EQ(out[2].nick, 2.0f);
+    for (uint32_t i=5; i<11; i++) in.receive(sample(i), i);
+    // the data wrap around the end of the buffer
+    uint16_t n;
+    const StreamSample<DATA_IMU_GYRO> *data = in.peek(&n);
+    CHECK_EQ(n, 5);
+    CHECK_EQ(data[0].data.nick, 3.0f);
+    CHECK_EQ(data[4].data.nick, 7.0f);
+    CHECK_EQ(data[4].cycles, 7);
+    in.consume(n);
+    data = in.peek(&n);
+    CHECK_EQ(n, 3);
+    CHECK_EQ(data[2].data.nick, 10.0f);
+    StreamSample<DATA_IMU_GYRO> samples[8];
+    CHECK_EQ(in.fetch_n(samples, 8), 3);
+    CHECK_EQ(samples[0].data.nick, 8.0f);
+    CHECK_EQ(samples[0].cycles, 8);
+    CHECK_EQ(in.fetch_n(out, 8), 0);
+    in.peek(&n);
+    CHECK_EQ(n, 0);
+}
+
+// the sender runs in its own thread like an interrupt would
+static void test_concurrent()
+{
+    const uint32_t N = 1000000;
+    StreamReceiver<DATA_IMU_GYRO> in;
+    in.set_capacity(64);
+    std::thread producer([&]() {
+        for (uint32_t i=0; i<N; i++) in.receive(sample(i), i);
+    });
+    // every data block received must be complete and in sequence
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    float last = -1.0f;
+    while (received + in.overruns() < N)
+    {
+        while (in.count() > 0)
+        {
+            DATA_IMU_GYRO data = in.fetch();
+            if ((data.nick <= last) or (data.yaw != -data.nick) or (data.roll != 0.5f)) errors++;
+            last = data.nick;
+            received++;
+        };
+    };
+    producer.join();
+    CHECK_EQ(errors, 0);
+    CHECK_EQ(received + in.overruns(), N);
+    CHECK_EQ(in.count(), 0);
+}
+
+int main()
+{
+    test_capacity();
+    test_order();
+    test_timestamps();
+    test_overrun();
+    test_batches();
+    test_concurrent();
+    return check_result("stream_ring");
+}
@@ -0,0 +1,56 @@
+/*
+    Typed messages and ports : the data struct is bound at compile time.
+*/
+
+#include <type_traits>
+#include <utility>
+
+#include "typed_port.h"
+#include "check.h"
+
+// if a sender port can be wired to a receiver port (resolved at compile time)
+template <typename S, typename R>
+static auto can_wire(int) ->
+    decltype(std::declval<S&>().set_receiver(std::declval<R*>()), std::true_type());
+template <typename S, typename R>
+static std::false_type can_wire(...);
+
+static_assert(decltype(can_wire<TypedSenderPort<MSG_DATA_SERVO>, TypedReceiverPort<MSG_DATA_SERVO>>(0))::value,
+    "ports of the same type can be wired");
+static_assert(!decltype(can_wire<TypedSenderPort<MSG_DATA_SERVO>, TypedReceiverPort<DATA_IMU_AHRS>>(0))::value,
+    "ports of different types cannot be wired");
+static_assert(!decltype(can_wire<SenderPort, TypedReceiverPort<DATA_IMU_AHRS>>(0))::value,
+    "untyped senders cannot be wired to typed receivers");
+
+int main()
+{
+    TypedSenderPort<MSG_DATA_SERVO> out;
+    TypedReceiverPort<MSG_DATA_SERVO> in;
+    out.set_receiver(&in);
+    MSG_DATA_SERVO servo = { { 1, 2, 3, 4, 5, 6, 7, 8 } };
+    uint16_t sender = FC_name_handle("TEST");
+    CHECK(out.transmit(sender, servo));
+    CHECK(out.transmit(TypedMessage<MSG_DATA_SERVO>(sender, servo)));
+    CHECK_EQ(in.count(), 2);
+    for (int k=0; k<2; k++)
+    {
+        TypedMessage<MSG_DATA_SERVO> msg = in.fetch();
+        CHECK_EQ(msg.message().type(), MSG_TYPE_SERVO);
+        CHECK_EQ(msg.message().size(), sizeof(MSG_DATA_SERVO));
+        CHECK_EQ(msg.sender(), sender);
+        for (int i=0; i<NUM_SERVO_CHANNELS; i++)
+            CHECK_EQ(msg.data().pos[i], i+1);
+    };
+    // a modification does not change the data of other copies
+    TypedMessage<DATA_IMU_AHRS> ahrs(sender, DATA_IMU_AHRS{ 1.0, 2.0, 3.0 });
+    TypedReceiverPort<DATA_IMU_AHRS> ahrs_in[2];
+    TypedSenderPort<DATA_IMU_AHRS> ahrs_out;
+    ahrs_out.set_receiver(&ahrs_in[0]);
+    ahrs_out.set_receiver(&ahrs_in[1]);
+    ahrs_out.transmit(std::move(ahrs));
+    TypedMessage<DATA_IMU_AHRS> first = ahrs_in[0].fetch();
+    first.get_data().heading = 90.0;
+    CHECK(first.data().heading == 90.0);
+    CHECK(ahrs_in[1].fetch().data().heading == 2.0);
+    return check_result("typed_port");
+}
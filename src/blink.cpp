@@ -20,27 +20,39 @@ Blink::Blink(
 	pinMode(13, OUTPUT);
 	// initialize the variables
 	state_on = false;
-    last_on_time = FC_time_now();
+	on_timer = -1;
+	off_timer = -1;
+    task_priority_ = TASK_PRIORITY_HOUSEKEEPING;
 }
 
-void Blink::interrupt()
+void Blink::setup()
 {
-    float elapsed = FC_elapsed_millis(last_on_time);
-    if (state_on and (elapsed >= 50.0))
-        schedule_task(this, std::bind(&Blink::switch_off, this));
-    if (elapsed*blink_rate >= 1000.0)
-        schedule_task(this, std::bind(&Blink::switch_on, this));
+    uint32_t period = 1000.0/blink_rate;
+    on_timer = schedule_periodic_task(this, TaskDelegate::create<Blink, &Blink::switch_on>(this), period);
+    if (on_timer < 0)
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
+    runlevel_ = MODULE_RUNLEVEL_OPERATIONAL;
+}
+
+Blink::~Blink()
+{
+    cancel_timer(this, on_timer);
+    cancel_timer(this, off_timer);
 }
 
 void Blink::switch_on()
 {
-    last_on_time = FC_time_now();
     digitalWriteFast(13, HIGH);
     state_on = true;
+    // the LED stays on for 50 ms
+    off_timer = schedule_delayed_task(this, TaskDelegate::create<Blink, &Blink::switch_off>(this), 50);
 }
 
 void Blink::switch_off()
 {
+    // the timer has expired, its ID may be given to another one
+    off_timer = -1;
     digitalWriteFast(13, LOW);
     state_on = false;
 }
@@ -19,15 +19,14 @@ public:
         float rate           // the blink rate in Hz
             );
 
-    // nothing to do
-    virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
+    // the LED is switched on by a periodic kernel timer
+    virtual void setup();
     
-    // This gets called once per millisecond from the systick interrupt.
-    // When necessary worker tasks are scheduled to switch the LED.
-    virtual void interrupt();
+    // the timers are cancelled
+    virtual ~Blink();
     
     // These are the worker function being executed by the taskmanager.
-    // They switch the LED on or off.
+    // They switch the LED on or off. switch_on() starts a timer for switch_off().
     // It is quite a bit overkill to use worker functions for this - immediate
     // switching could well be performed within the timing constraints of the interrupt.
     // This serves as an example for more expensive modules where this approach is necessary.
@@ -39,6 +38,7 @@ private:
 
     float       blink_rate;
     bool        state_on;
-    uint32_t    last_on_time;
+    int         on_timer;       // the kernel timer of switch_on() (-1 if none)
+    int         off_timer;      // the kernel timer of switch_off() while it is waiting
     
 };
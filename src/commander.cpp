@@ -12,60 +12,65 @@ Commander::Commander(
     ) : Module(name)
 {
     robot_state = ROBOT_IDLE;
+    activate_timer = -1;
     runlevel_ = MODULE_RUNLEVEL_STOP;
+    task_priority_ = TASK_PRIORITY_CONTROL;
+    command_in.set_handler(this, TaskDelegate::create<Commander, &Commander::handle_uplink>(this));
 }
 
 void Commander::setup()
 {
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
     runlevel_ = MODULE_RUNLEVEL_OPERATIONAL;
+    // we take command with the first tick of the running system
+    activate_timer = schedule_delayed_task(this,
+        TaskDelegate::create<Commander, &Commander::activate>(this), 1);
+    if (activate_timer < 0)
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
+};
+
+Commander::~Commander()
+{
+    cancel_timer(this, activate_timer);
 };
 
 void Commander::activate()
 {
+    // the timer has expired, its ID may be given to another one
+    activate_timer = -1;
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_MILESTONE, "taking command.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_MILESTONE, "taking command.") );
     runlevel_ = MODULE_RUNLEVEL_COMMANDER_PIC;
 };
 
-void Commander::interrupt()
-{
-	if (runlevel_ == MODULE_RUNLEVEL_OPERATIONAL)
-	{
-		// upon the first interrupt call we take command
-		schedule_task(this, std::bind(&Commander::activate, this));
-	}
-    if (runlevel_ == MODULE_RUNLEVEL_COMMANDER_PIC)
-    {
-        // If there is something received in one of the input ports we have to handle it.
-        // We could do that right here as it takes almost no time
-        if (command_in.count()>0)
-        {
-            schedule_task(this, std::bind(&Commander::handle_uplink, this));
-        }
-    }
-}
-
 void Commander::handle_uplink()
 {
-    /* TODO: at present we don't do anything
-    Message msg = command_in.fetch();
-    // process the command messages
-    if (msg.type()==MSG_TYPE_COMMAND)
+    // all messages are taken from the port, this is only scheduled when new ones arrive
+    while (command_in.count() > 0)
     {
-        uint16_t msg_size = msg.size();
-        char* msg_body = (char*) msg.get_data();
-        // send read-back
-        std::stringstream ss;
-        ss << "received command : ";
-        ss << hexbyte(msg_body[0]);
-        ss << hexbyte(msg_body[1]);
-        ss << " size = " << msg_size;
-        Message read_back = Message::SystemMessage(
-            id, FC_time_now(), MSG_LEVEL_READBACK, ss.str());
-        status_out.transmit(read_back);        
+        Message msg = command_in.fetch();
+        // commands are only accepted while we are in command,
+        // the ones received before are discarded
+        if (runlevel_ != MODULE_RUNLEVEL_COMMANDER_PIC) continue;
+        /* TODO: at present we don't do anything
+        // process the command messages
+        if (msg.type()==MSG_TYPE_COMMAND)
+        {
+            uint16_t msg_size = msg.size();
+            const char* msg_body = (const char*) msg.data();
+            // send read-back
+            std::stringstream ss;
+            ss << "received command : ";
+            ss << hexbyte(msg_body[0]);
+            ss << hexbyte(msg_body[1]);
+            ss << " size = " << msg_size;
+            Message read_back = Message::SystemMessage(
+                id, FC_time_now(), MSG_LEVEL_READBACK, ss.str());
+            status_out.transmit(read_back);        
+        };
+        */
     };
-    */
 };
 
@@ -31,13 +31,16 @@ public:
 
     virtual void setup();
     
+    // a waiting activation is cancelled
+    virtual ~Commander();
+    
     // when all initializations are done the commander takes over
-    // TODO: this should be execute first thing when entering the event loop
+    // this is scheduled from setup() to be executed right after the
+    // event loop has been entered
     void activate();
     
-    virtual void interrupt();
-    
     // this is for handling commands that are sent over the uplink from ground control
+    // it is scheduled when a message arrives at command_in
     virtual void handle_uplink();
     
     // port over which status messages are sent
@@ -50,4 +53,7 @@ private:
 
     int robot_state;
     
+    // the kernel timer of activate() while it is waiting (-1 if none)
+    int activate_timer;
+    
 };
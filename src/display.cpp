@@ -31,6 +31,7 @@ DisplaySSD1331::DisplaySSD1331(
     ) : Module(name)
 {
     update_rate = rate;
+    update_timer = -1;
     // create the display
     display = new Adafruit_SSD1331(&SPI, DISPLAY_CS, DISPLAY_DC, DISPLAY_RST);
     // set some defaults
@@ -45,6 +46,12 @@ DisplaySSD1331::DisplaySSD1331(
     last_update = FC_time_now();
     update_state = DISPLAY_UNINITIALIZED;
     flag_update_running = false;
+    task_priority_ = TASK_PRIORITY_HOUSEKEEPING;
+    // the display is paced by the systick
+    uses_interrupt_ = true;
+    // all received messages are handled by the same task
+    // the streams are not handled per data block, they are read with every display update
+    data_in.set_handler(this, TaskDelegate::create<DisplaySSD1331, &DisplaySSD1331::update_data>(this));
 }
 
 void DisplaySSD1331::setup()
@@ -56,73 +63,91 @@ void DisplaySSD1331::setup()
     while (FC_elapsed_millis(last_update)<1000) {};
     display->fillScreen(BLACK);
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
     update_state=DISPLAY_COMPLETE;
     
     flag_update_running = false;
     
     last_update = FC_time_now();
+    uint32_t period = 1000.0/update_rate;
+    update_timer = schedule_periodic_task(this,
+        TaskDelegate::create<DisplaySSD1331, &DisplaySSD1331::start_update>(this), period);
+    if (update_timer < 0)
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
     runlevel_ = MODULE_RUNLEVEL_OPERATIONAL;
 };
 
+DisplaySSD1331::~DisplaySSD1331()
+{
+    cancel_timer(this, update_timer);
+};
+
 void DisplaySSD1331::interrupt()
 {
     if (runlevel_ == MODULE_RUNLEVEL_OPERATIONAL)
     {
-        // If there is something received in one of the input ports we have to handle it.
-        // We can do that right here as it takes almost no time
-        if (data_in.count()>0)
-        {
-            Message msg = data_in.fetch();
-            // process the messages we can handle
-            if (msg.type()==MSG_TYPE_IMU_AHRS)
-            {
-                DATA_IMU_AHRS *data = (DATA_IMU_AHRS*) msg.get_data();
-                heading = data->heading;
-                pitch = data->attitude;
-                roll = data->roll;
-            };
-            if (msg.type()==MSG_TYPE_IMU_GYRO)
-            {
-                DATA_IMU_GYRO *data = (DATA_IMU_GYRO*) msg.get_data();
-                gx = data->roll;
-                gy = data->nick;
-                gz = data->yaw;
-            };
-        }
-        if (ahrs_in.count()>0)
-        {
-            DATA_IMU_AHRS data = ahrs_in.fetch();
-            heading = data.heading;
-            pitch = data.attitude;
-            roll = data.roll;
-        }
-        if (gyro_in.count()>0)
-        {
-            DATA_IMU_GYRO data = gyro_in.fetch();
-            gx = data.roll;
-            gy = data.nick;
-            gz = data.yaw;
-        }
         // If there is an update running we have to request a task for that
         if (flag_update_running)
         {
             // insert the redraw() routine into the tasklist
-            schedule_task(this, std::bind(&DisplaySSD1331::redraw, this));
-        } else {
-            // when due, start a new update
-            if (FC_elapsed_millis(last_update)*update_rate>1000)
-            {
-                last_update = FC_time_now();
-                update_state = DISPLAY_CLEAR;
-                cycle_count = 0;
-                // this will become effective with the next interrupt
-                flag_update_running = true;
-            }
+            schedule_task(this, TaskDelegate::create<DisplaySSD1331, &DisplaySSD1331::redraw>(this));
         }
     }
 }
 
+void DisplaySSD1331::update_data()
+{
+    // the data are stored and will show up with the next display update
+    while (data_in.count()>0)
+    {
+        Message msg = data_in.fetch();
+        // process the messages we can handle
+        if (msg.type()==MSG_TYPE_IMU_AHRS)
+        {
+            const DATA_IMU_AHRS *data = (const DATA_IMU_AHRS*) msg.data();
+            heading = data->heading;
+            pitch = data->attitude;
+            roll = data->roll;
+        };
+        if (msg.type()==MSG_TYPE_IMU_GYRO)
+        {
+            const DATA_IMU_GYRO *data = (const DATA_IMU_GYRO*) msg.data();
+            gx = data->roll;
+            gy = data->nick;
+            gz = data->yaw;
+        };
+    }
+}
+
+void DisplaySSD1331::start_update()
+{
+    // if the previous update takes longer than the period we skip one
+    if ((runlevel_ == MODULE_RUNLEVEL_OPERATIONAL) and !flag_update_running)
+    {
+        // the latest stream data (the values are kept if nothing has been received)
+        DATA_IMU_AHRS ahrs;
+        if (ahrs_in.read(&ahrs) != 0)
+        {
+            heading = ahrs.heading;
+            pitch = ahrs.attitude;
+            roll = ahrs.roll;
+        };
+        DATA_IMU_GYRO gyro;
+        if (gyro_in.read(&gyro) != 0)
+        {
+            gx = gyro.roll;
+            gy = gyro.nick;
+            gz = gyro.yaw;
+        };
+        last_update = FC_time_now();
+        update_state = DISPLAY_CLEAR;
+        cycle_count = 0;
+        // this will become effective with the next interrupt
+        flag_update_running = true;
+    }
+}
+
 // redraw gets called many times until the full display refresh has been accomplished
 void DisplaySSD1331::redraw()
 {
@@ -37,8 +37,22 @@ public:
     // TODO: move initializations here
     virtual void setup();
     
+    // the timer is cancelled
+    virtual ~DisplaySSD1331();
+    
+    // While a display update is running this schedules redraw()
+    // with every systick, so one character is transfered per millisecond.
     virtual void interrupt();
     
+    // This is the worker function scheduled when messages arrive at data_in.
+    // The values on display are updated with all data received.
+    void update_data();
+    
+    // This is the worker function being executed by a periodic kernel timer
+    // at the update rate. It starts a new display update unless one is still running.
+    // The latest stream data are taken for this update.
+    void start_update();
+    
     // This is the worker function being executed by the taskmanager.
     // It manages all drawing.
     virtual void redraw();
@@ -51,9 +65,10 @@ public:
     // data are stored internally and will be updated during the next display cycle
     ReceiverPort data_in;
 
-    // a receiver for data streams
-    StreamReceiver<DATA_IMU_AHRS> ahrs_in;
-    StreamReceiver<DATA_IMU_GYRO> gyro_in;
+    // the receivers for data streams
+    // only the latest data are kept, they are read when an update starts
+    StreamMailbox<DATA_IMU_AHRS> ahrs_in;
+    StreamMailbox<DATA_IMU_GYRO> gyro_in;
     
 private:
 
@@ -69,8 +84,9 @@ private:
     float       gx, gy, gz;
     
     float       update_rate;    // the update rate of the display
+    int         update_timer;   // the kernel timer of start_update() (-1 if none)
     uint8_t     update_state;   // state machine controlling the display update
-    uint32_t    last_update;    // the time of the last update
+    uint32_t    last_update;    // the time of the last update (used during setup)
     int         cycle_count;    // number of cycles performed on a display print action
     int         num_cycles;     // the number of cycles (characters) to complete the print
     char        buffer[18];     // the print buffer for one display line (max. 16 characters)
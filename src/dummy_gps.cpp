@@ -1,8 +1,6 @@
-#include <cstdio>
-
-#include "kernel.h"
 #include "kernel.h"
 #include "dummy_gps.h"
+#include "telemetry.h"
 
 DummyGPS::DummyGPS(
     std::string name,
@@ -11,13 +9,15 @@ DummyGPS::DummyGPS(
 {
     runlevel_= MODULE_RUNLEVEL_INITALIZED;
     gps_rate = rate;
+    update_timer = -1;
+    tm_timer = -1;
     telemetry_rate = tm_rate;
+    tm_declared = false;
+    tm_registered = false;
+    tm_hash = 0;
     startup_time = FC_time_now();
     flag_state_change = true;
-    flag_update_pending = false;
     last_update = FC_time_now();
-    flag_telemetry_pending = false;
-    last_telemetry = FC_time_now();
     status_lock = false;
     // home position
     lat = 51.04943;
@@ -31,17 +31,24 @@ DummyGPS::DummyGPS(
     runlevel_=MODULE_RUNLEVEL_OPERATIONAL;
 }
 
-void DummyGPS::interrupt()
+void DummyGPS::setup()
 {
-    float elapsed = FC_elapsed_millis(last_update);
-    flag_update_pending = (elapsed*gps_rate >= 1000.0);
-    
-    elapsed = FC_elapsed_millis(last_telemetry);
-    flag_telemetry_pending = (elapsed*telemetry_rate >= 1000.0);
-
-    // insert the run() routine into the tasklist
-    if (flag_state_change | flag_update_pending | flag_telemetry_pending)
-        schedule_task(this, std::bind(&DummyGPS::run, this));
+    uint32_t period = 1000.0/gps_rate;
+    update_timer = schedule_periodic_task(this,
+        TaskDelegate::create<DummyGPS, &DummyGPS::update>(this), period);
+    // a telemetry rate of zero means no telemetry is sent
+    // the telemetry is shifted by half a period against the position updates
+    if (telemetry_rate > 0.0)
+    {
+        period = 1000.0/telemetry_rate;
+        tm_timer = schedule_periodic_task(this,
+            TaskDelegate::create<DummyGPS, &DummyGPS::send_telemetry>(this), period, period/2);
+    };
+    if ((update_timer < 0) or ((telemetry_rate > 0.0) and (tm_timer < 0)))
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
+    last_update = FC_time_now();
+    runlevel_ = MODULE_RUNLEVEL_OPERATIONAL;
 }
 
 #define DEGREE_PER_METER 9e-6
@@ -49,50 +56,27 @@ void DummyGPS::interrupt()
 // delivers positive numbers running 0...2147483647
 #define MAX_RANDOM 2147483648.0
 
-void DummyGPS::run()
+void DummyGPS::update()
 {
     
-    if (flag_update_pending)
-    {
-        // time in seconds
-        float elapsed = 0.001 * FC_elapsed_millis(last_update);
-        // velocity damping
-        vx -= 0.2 * vx * elapsed;
-        vy -= 0.2 * vy * elapsed;
-        vz -= 0.5 * vz * elapsed;
-        // random velocity change
-        vx += 0.5 * elapsed * random()/MAX_RANDOM;
-        vy += 0.5 * elapsed * random()/MAX_RANDOM;
-        vz += 1.0 * elapsed * random()/MAX_RANDOM;
-        // position change
-        lat += vy * elapsed * DEGREE_PER_METER;
-        lon += vx * elapsed * DEGREE_PER_METER;
-        alt += vz * elapsed;
-
-        // TODO: send message
-        
-        last_update = FC_time_now();
-        flag_update_pending = false;
-    };
-
-    if (flag_telemetry_pending)
-    {
-        char buffer[16];
-        int n = snprintf(buffer, 15, "%.6f", lat);
-        tm_out.transmit(
-            Message::TelemetryMessage(id, FC_time_now(), "GPS_LAT", std::string(buffer,n)) );
-
-        n = snprintf(buffer, 15, "%.6f", lon);
-        tm_out.transmit(
-            Message::TelemetryMessage(id, FC_time_now(), "GPS_LONG", std::string(buffer,n)) );
+    // time in seconds
+    float elapsed = 0.001 * FC_elapsed_millis(last_update);
+    // velocity damping
+    vx -= 0.2 * vx * elapsed;
+    vy -= 0.2 * vy * elapsed;
+    vz -= 0.5 * vz * elapsed;
+    // random velocity change
+    vx += 0.5 * elapsed * random()/MAX_RANDOM;
+    vy += 0.5 * elapsed * random()/MAX_RANDOM;
+    vz += 1.0 * elapsed * random()/MAX_RANDOM;
+    // position change
+    lat += vy * elapsed * DEGREE_PER_METER;
+    lon += vx * elapsed * DEGREE_PER_METER;
+    alt += vz * elapsed;
 
-        n = snprintf(buffer, 15, "%.2f", alt);
-        tm_out.transmit(
-            Message::TelemetryMessage(id, FC_time_now(), "GPS_ALTI", std::string(buffer,n)) );
-
-        last_telemetry = FC_time_now();
-        flag_telemetry_pending = false;
-    };
+    // TODO: send message
+    
+    last_update = FC_time_now();
     
     // after 5s the GPS has acquired a lock
     if (!status_lock)
@@ -111,24 +95,45 @@ void DummyGPS::run()
         {
             runlevel_=MODULE_RUNLEVEL_LINK_OPEN;
             system_log->in.receive(
-                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "acquired lock.") );
+                Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "acquired lock.") );
         } else {
             runlevel_=MODULE_RUNLEVEL_OPERATIONAL;
             system_log->in.receive(
-                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_MILESTONE, "up and running.") );
+                Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_MILESTONE, "up and running.") );
         };
         flag_state_change = false;
     };
     
 }
 
+void DummyGPS::send_telemetry()
+{
+    // the ports are wired after setup(), so the variable is declared here
+    if (!tm_declared)
+    {
+        tm_registered = FC_telemetry_declare(handle(), "GPS_POS", &tm_hash);
+        if (tm_registered)
+            tm_out.transmit(Message::TelemetryVariable(handle(), tm_hash, "GPS_POS"));
+        else
+            status_out.transmit(
+                Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "telemetry variable not registered.") );
+        tm_declared = true;
+    };
+    if (!tm_registered) return;
+    MSG_DATA_GPS_POSITION data {
+        .latitude = lat,
+        .longitude = lon,
+        .altitude = alt };
+    tm_out.transmit(Message::DataMessage(handle(), tm_hash, FC_time_now(), data));
+}
+
 Message DummyGPS::get_position()
 {
     MSG_DATA_GPS_POSITION data {
         .latitude = lat,
         .longitude = lon,
         .altitude = alt };
-    Message msg(id, MSG_TYPE_GPS_POSITION, sizeof(MSG_DATA_GPS_POSITION), &data);
+    Message msg(handle(), MSG_TYPE_GPS_POSITION, sizeof(MSG_DATA_GPS_POSITION), &data);
     return msg;
 }
 
@@ -25,17 +25,20 @@ public:
         float tm_rate        // the rate at which telemetry messages are sent
             );
     
-    // nothing to do
-    virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
+    // the updates are registered with the kernel timers
+    virtual void setup();
     
-    virtual void interrupt();
+    // This is the worker function being executed by the taskmanager at the GPS rate.
+    // It simulates GPS coordinates and reports state changes.
+    void update();
 
-    // This is the worker function being executed by the taskmanager.
-    // It simulates GPS coordinates and sends according messages.
-    virtual void run();
+    // This is the worker function being executed by the taskmanager at the telemetry rate.
+    // It sends the current position as a binary telemetry record (variable GPS_POS).
+    // The variable is declared with the first call.
+    void send_telemetry();
 
-    // destructor
-    virtual ~DummyGPS() {};
+    // destructor, the timers are cancelled
+    virtual ~DummyGPS() { cancel_timer(this, update_timer); cancel_timer(this, tm_timer); };
 
     // assemble a position message from current data upon request
     Message get_position();
@@ -60,15 +63,17 @@ private:
     float       vz;         // simulated velocity in up direction [m/s]
 
     uint32_t    startup_time;
+    int         update_timer;   // the kernel timer of update() (-1 if none)
+    int         tm_timer;       // the kernel timer of send_telemetry() (-1 if none)
     float       gps_rate;
     uint32_t    last_update;
     float       telemetry_rate;
-    uint32_t    last_telemetry;
+    bool        tm_declared;
+    bool        tm_registered;  // if the telemetry variable could be registered
+    uint16_t    tm_hash;        // the hash of the telemetry variable
     
     // here are some flags indicating which work is due
     bool        flag_state_change;
-    bool        flag_update_pending;
-    bool        flag_telemetry_pending;
     
     bool        status_lock;
 };
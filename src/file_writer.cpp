@@ -1,3 +1,8 @@
+#include <cstring>
+
+// this is needed to have F_CPU_ACTUAL
+#include "wiring.h"
+
 #include "file_writer.h"
 #include "kernel.h"
 #include "kernel.h"
@@ -11,8 +16,9 @@ FileWriter::FileWriter(
     id = name;
     runlevel_= MODULE_RUNLEVEL_INITALIZED;
     fileName = file_name;
+    flush_timer = -1;
+    in.set_handler(this, TaskDelegate::create<FileWriter, &FileWriter::handle_MSG>(this));
     runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
-    last_flush = FC_time_now();
 }
 
 void FileWriter::setup()
@@ -22,48 +28,62 @@ void FileWriter::setup()
     if (myFile)
     {
         runlevel_= MODULE_RUNLEVEL_LINK_OPEN;
+        // make sure all buffered data is written to the card every 5 seconds
+        flush_timer = schedule_periodic_task(this,
+            TaskDelegate::create<FileWriter, &FileWriter::flush>(this), 5000);
+        if (flush_timer < 0)
+            system_log->in.receive(
+                Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
         system_log->in.receive(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_MILESTONE, "file opened.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_MILESTONE, "file opened.") );
     }
     else
         runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
 }
 
-void FileWriter::interrupt()
-{
-    if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN)
-    {
-        if (in.count()>0)
-            schedule_task(this, std::bind(&FileWriter::handle_MSG, this));
-        if (FC_elapsed_millis(last_flush) > 5000)
-            schedule_task(this, std::bind(&FileWriter::flush, this));
-    };
-}
-
 void FileWriter::handle_MSG()
 {
-    if (in.count()>0)
+    uint64_t start = FC_time_us();
+    size_t fill = 0;
+    while (in.count()>0)
     {
-        Message msg = in.fetch();
-        // write to file
-        std::string buffer = msg.printout();
-        buffer += std::string("\r\n");
-        // write out
-        // the write is buffered and should return immediately
-        // if the is data flushed to card it may take longer
-        myFile.write(buffer.c_str(), buffer.size());
-        // TODO: handle write failures
+        uint16_t n;
+        Message *msg = in.peek(&n);
+        // without an open file the messages are discarded
+        if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN)
+            for (uint16_t i=0; i<n; i++)
+            {
+                // the buffer is written out if the next message may not fit
+                if (fill + MSG_MAX_PRINTOUT+3 > FILE_WRITER_BUFFER)
+                {
+                    myFile.write(batch, fill);
+                    fill = 0;
+                };
+                fill += msg[i].printout(batch+fill, MSG_MAX_PRINTOUT+1);
+                batch[fill++] = '\r';
+                batch[fill++] = '\n';
+            };
+        in.consume(n);
+        if (FC_time_us() - start > FILE_WRITER_BUDGET_US) break;
     };
+    // write out
+    // the write is buffered and should return immediately
+    // if the is data flushed to card it may take longer
+    if (fill > 0) myFile.write(batch, fill);
+    // TODO: handle write failures
+    // the remaining messages are handled in a separate task
+    if (in.count()>0)
+        schedule_task(this, TaskDelegate::create<FileWriter, &FileWriter::handle_MSG>(this));
 }
 
 void FileWriter::flush()
 {
     myFile.flush();
-    last_flush = FC_time_now();
 }
 
 FileWriter::~FileWriter()
 {
+    cancel_timer(this, flush_timer);
     myFile.close();
 }
 
@@ -75,8 +95,12 @@ StreamFileWriter::StreamFileWriter(
     id = name;
     runlevel_= MODULE_RUNLEVEL_INITALIZED;
     fileName = file_name;
+    flush_timer = -1;
+    ahrs_in.set_handler(this,
+        TaskDelegate::create<StreamFileWriter, &StreamFileWriter::handle_AHRS>(this));
+    gyro_in.set_handler(this,
+        TaskDelegate::create<StreamFileWriter, &StreamFileWriter::handle_GYRO>(this));
     runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
-    last_flush = FC_time_now();
 }
 
 void StreamFileWriter::setup()
@@ -86,70 +110,153 @@ void StreamFileWriter::setup()
     if (myFile)
     {
         runlevel_= MODULE_RUNLEVEL_LINK_OPEN;
+        // make sure all buffered data is written to the card every 5 seconds
+        // shifted by half a period against the system log
+        flush_timer = schedule_periodic_task(this,
+            TaskDelegate::create<StreamFileWriter, &StreamFileWriter::flush>(this), 5000, 2500);
+        if (flush_timer < 0)
+            system_log->in.receive(
+                Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
         system_log->in.receive(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_MILESTONE, "file opened.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_MILESTONE, "file opened.") );
     }
     else
         runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
 }
 
-void StreamFileWriter::interrupt()
+template <typename datatype>
+bool StreamFileWriter::write_stream(StreamReceiver<datatype>& in, uint8_t signature)
 {
-    if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN)
+    static_assert(sizeof(datatype) <= sizeof(DATA_IMU_AHRS), "the dataset must fit the batch buffer");
+    uint64_t start = FC_time_us();
+    while (in.count()>0)
     {
-        if (ahrs_in.count()>0)
-            schedule_task(this, std::bind(&StreamFileWriter::handle_AHRS, this));
-        if (gyro_in.count()>0)
-            schedule_task(this, std::bind(&StreamFileWriter::handle_GYRO, this));
-        if (FC_elapsed_millis(last_flush) > 5000)
-            schedule_task(this, std::bind(&StreamFileWriter::flush, this));
+        uint16_t n;
+        const StreamSample<datatype> *data = in.peek(&n);
+        if (n > STREAM_FILE_BATCH) n = STREAM_FILE_BATCH;
+        if (runlevel_== MODULE_RUNLEVEL_LINK_OPEN)
+        {
+            // every dataset consists of signature, timestamp and data
+            uint8_t *p = batch;
+            for (uint16_t i=0; i<n; i++)
+            {
+                *p++ = signature;
+                uint64_t time = FC_cycles_to_ns(data[i].cycles);
+                memcpy(p, &time, 8);
+                p += 8;
+                memcpy(p, &data[i].data, sizeof(datatype));
+                p += sizeof(datatype);
+            };
+            myFile.write(batch, p-batch);
+        };
+        // TODO: handle write failures
+        in.consume(n);
+        if (FC_time_us() - start > FILE_WRITER_BUDGET_US) break;
     };
+    return (in.count()>0);
 }
 
 void StreamFileWriter::handle_AHRS()
 {
-    if (ahrs_in.count()>0)
-    {
-        // get the message from the queue
-        uint8_t sig = DATA_IMU_AHRS_SIGNATURE;
-        uint32_t time = FC_time_now();
-        DATA_IMU_AHRS data = ahrs_in.fetch();
-        if (runlevel_== MODULE_RUNLEVEL_LINK_OPEN)
-        {
-            myFile.write(&sig,1);
-            myFile.write(&time,4);
-            myFile.write(&data,12);
-        };        
-        // TODO: handle write failures
-    };
+    if (write_stream(ahrs_in, DATA_IMU_AHRS_SIGNATURE))
+        schedule_task(this, TaskDelegate::create<StreamFileWriter, &StreamFileWriter::handle_AHRS>(this));
 }
     
 void StreamFileWriter::handle_GYRO()
 {
-    if (gyro_in.count()>0)
-    {
-        // get the message from the queue
-        uint8_t sig = DATA_IMU_GYRO_SIGNATURE;
-        uint32_t time = FC_time_now();
-        DATA_IMU_GYRO data = gyro_in.fetch();
-        if (runlevel_== MODULE_RUNLEVEL_LINK_OPEN)
-        {
-            myFile.write(&sig,1);
-            myFile.write(&time,4);
-            myFile.write(&data,12);
-        };        
-        // TODO: handle write failures
-    };
+    if (write_stream(gyro_in, DATA_IMU_GYRO_SIGNATURE))
+        schedule_task(this, TaskDelegate::create<StreamFileWriter, &StreamFileWriter::handle_GYRO>(this));
 }
 
 void StreamFileWriter::flush()
 {
     myFile.flush();
-    last_flush = FC_time_now();
 }
 
 StreamFileWriter::~StreamFileWriter()
 {
+    cancel_timer(this, flush_timer);
     myFile.close();
 }
 
+TraceFileWriter::TraceFileWriter(
+        std::string name,
+        std::string file_name,
+        uint32_t delay_ms) : Module(name)
+{
+    runlevel_= MODULE_RUNLEVEL_INITALIZED;
+    fileName = file_name;
+    dump_delay = delay_ms;
+    dump_timer = -1;
+    num_events = 0;
+    events_written = 0;
+    task_priority_ = TASK_PRIORITY_HOUSEKEEPING;
+    runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
+}
+
+void TraceFileWriter::setup()
+{
+    // open the file
+    myFile = SD.open(fileName.c_str(), FILE_WRITE);
+    if (myFile)
+    {
+        runlevel_= MODULE_RUNLEVEL_LINK_OPEN;
+        dump_timer = schedule_delayed_task(this,
+            TaskDelegate::create<TraceFileWriter, &TraceFileWriter::dump>(this), dump_delay);
+        if (dump_timer < 0)
+            system_log->in.receive(
+                Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
+        system_log->in.receive(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_MILESTONE, "file opened.") );
+    }
+    else
+        runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
+}
+
+void TraceFileWriter::dump()
+{
+    // the timer has expired, its ID may be given to another one
+    dump_timer = -1;
+    if (runlevel_ != MODULE_RUNLEVEL_LINK_OPEN) return;
+    if (events_written == 0)
+    {
+        // stop recording, the trace ends here
+        FC_trace_freeze(true);
+        num_events = FC_trace_count();
+        // write the header
+        myFile.write("TAROSTRC", 8);
+        uint32_t clock = F_CPU_ACTUAL;
+        myFile.write(&clock, 4);
+        uint32_t num_modules = FC_num_modules();
+        myFile.write(&num_modules, 4);
+        for (uint32_t i=0; i<num_modules; i++)
+        {
+            char name[8] = {0};
+            Module *mod = FC_module(i);
+            if (mod != 0)
+                memcpy(name, mod->id.data(), (mod->id.size() < 8) ? mod->id.size() : 8);
+            myFile.write(name, 8);
+        };
+        myFile.write(&num_events, 4);
+    };
+    // write one chunk of events
+    TraceEvent chunk[TRACE_FILE_CHUNK];
+    uint32_t n = FC_trace_read(chunk, events_written, TRACE_FILE_CHUNK);
+    myFile.write(chunk, n*sizeof(TraceEvent));
+    events_written += n;
+    if ((n > 0) and (events_written < num_events))
+        schedule_task(this, TaskDelegate::create<TraceFileWriter, &TraceFileWriter::dump>(this));
+    else
+    {
+        myFile.close();
+        runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
+        system_log->in.receive(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_MILESTONE, "trace written.") );
+    };
+}
+
+TraceFileWriter::~TraceFileWriter()
+{
+    cancel_timer(this, dump_timer);
+    if (runlevel_ == MODULE_RUNLEVEL_LINK_OPEN) myFile.close();
+}
@@ -9,9 +9,23 @@
 #include "port.h"
 #include "stream.h"
 
+// the time a writer task may spend on writing queued data before it yields
+// (the rest is written by the next task)
+#ifndef FILE_WRITER_BUDGET_US
+#define FILE_WRITER_BUDGET_US 500
+#endif
+
+// the size of the buffer of the FileWriter in which messages are collected to be written at once
+#define FILE_WRITER_BUFFER 2048
+
+// the number of stream data blocks written at once by the StreamFileWriter
+#define STREAM_FILE_BATCH 32
+
 /*  
     This is a module for logging messages.
-    It writes all received text messages (serialized) to a file.
+    It writes all received messages (serialized) to a file.
+    All messages waiting are formatted into the buffer of the writer
+    and written at once (as long as the time budget of the task is not used up).
     
     MODULE_RUNLEVEL_LINK_OPEN indicates that the file has been successfully opened
     and can be written to. If this is not the case all incoming messages are quietly discarded
@@ -31,12 +45,13 @@ public:
     // here the file is actually opened
     virtual void setup();
     
-    virtual void interrupt();
-
-    // process an incoming message
+    // process the incoming messages
+    // This is scheduled when a message arrives at the input port.
+    // If not all messages are written within FILE_WRITER_BUDGET_US
+    // the task schedules itself again.
     virtual void handle_MSG();
     
-    // Once per second we make sure all buffered data is flushed to the card
+    // Every 5 seconds we make sure all buffered data is flushed to the card
     virtual void flush();
 
     // destructor
@@ -45,16 +60,17 @@ public:
     // still, data loss may occur
     virtual ~FileWriter();
 
-    // port at which text messages are received to be written to the file
+    // port at which messages are received to be written to the file
     ReceiverPort in;
 
 private:
 
     std::string fileName;
     File myFile;
-    
-    // we flush once per second
-    uint32_t last_flush;
+    // the kernel timer of flush() (-1 if none)
+    int flush_timer;
+    // the formatted messages with CR/LF
+    char batch[FILE_WRITER_BUFFER];
     
 };
 
@@ -63,6 +79,11 @@ private:
     This is a module for logging streams.
     It writes all received stream to a file.
     It adds a type signature and a timestamp to every dataset.
+    The datasets waiting are written in blocks of STREAM_FILE_BATCH.
+    
+    Every dataset consists of the signature (uint8_t, see types.h),
+    the time when the data were produced in nanoseconds (uint64_t, see FC_cycles_to_ns())
+    and the data. All data are little-endian.
     
     MODULE_RUNLEVEL_LINK_OPEN indicates that the file has been successfully opened
     and can be written to. If this is not the case all incoming messages are quietly discarded
@@ -82,15 +103,17 @@ public:
     // here the file is actually opened
     virtual void setup();
     
-    virtual void interrupt();
-    
     // handle incomming messages on ahrs_in
+    // scheduled on arrival of data, all datasets waiting are written
+    // (within the time budget, otherwise the task schedules itself again)
     virtual void handle_AHRS();
 
     // handle incomming messages on gyro_in
+    // scheduled on arrival of data, all datasets waiting are written
+    // (within the time budget, otherwise the task schedules itself again)
     virtual void handle_GYRO();
 
-    // Once per second we make sure all buffered data is flushed to the card
+    // Every 5 seconds we make sure all buffered data is flushed to the card
     virtual void flush();
 
     // destructor
@@ -105,10 +128,68 @@ public:
 
 private:
 
+    // write the datasets waiting at the receiver
+    // this returns true if there are datasets left
+    template <typename datatype>
+    bool write_stream(StreamReceiver<datatype>& in, uint8_t signature);
+
     std::string fileName;
     File myFile;
+    // the kernel timer of flush() (-1 if none)
+    int flush_timer;
+    // a block of datasets : signature, timestamp and data
+    uint8_t batch[STREAM_FILE_BATCH * (9 + sizeof(DATA_IMU_AHRS))];
+    
+};
+
+
+/*  
+    This is a module for writing the kernel trace to a file.
+    After the given time has elapsed the trace is frozen and the
+    whole trace buffer is written to the file (in chunks, one per task call).
+    The file can be converted with test/trace_to_chrome.py.
+    
+    The file starts with the signature "TAROSTRC" followed by the CPU clock
+    frequency (uint32_t), the number of modules (uint32_t) and the IDs of all
+    modules (8 characters each, zero-padded) in the order of their index.
+    Then the number of events (uint32_t) and all trace events follow
+    (8 bytes each, see TraceEvent in kernel.h). All data are little-endian.
+    
+    MODULE_RUNLEVEL_LINK_OPEN indicates that the file has been successfully opened.
+*/
+#define TRACE_FILE_CHUNK 128
+
+class TraceFileWriter : public Module
+{
+
+public:
+
+    // constructor
+    TraceFileWriter(
+        std::string name,
+        std::string file_name,
+        uint32_t delay_ms           // the time after setup() at which the trace is dumped
+        );
+    
+    // here the file is opened and the dump is scheduled
+    virtual void setup();
     
-    // we flush once per second
-    uint32_t last_flush;
+    // write the next chunk of the trace
+    // this reschedules itself until the complete trace is written
+    void dump();
+
+    // destructor
+    virtual ~TraceFileWriter();
+
+private:
+
+    std::string fileName;
+    File myFile;
+    uint32_t dump_delay;
+    // the kernel timer starting the dump while it is waiting (-1 if none)
+    int dump_timer;
+    // the number of events to be written and already written
+    uint32_t num_events;
+    uint32_t events_written;
     
 };
@@ -1,8 +1,11 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include "kernel.h"
 #include "module.h"
 
 // this is needed to have ARM_DWT_CYCCNT and F_CPU_ACTUAL
-#include "../core/core_pins.h"
+#include "core_pins.h"
 
 // These 2 variables are part of the Teensyduino core.
 // They are only included for the systick interupt service routine.
@@ -27,9 +30,76 @@ uint32_t FC_elapsed_millis(uint32_t timestamp)
 // we store its value with every systick to procide sub-millisecond timing
 static volatile uint32_t FC_systick_cycle_count;
 
+// The 64-bit cycle count is kept as the number of wrap-arounds of ARM_DWT_CYCCNT.
+// With every systick FC_cycle_epoch is set to bits 31...62 of the 64-bit count
+// (the upper word shifted left by one plus the top bit of the counter).
+// Between two systicks the counter advances by much less than 2^31 cycles,
+// so if the top bit was set at the last systick and is cleared now,
+// the counter has wrapped around since and the upper word is one more.
+static uint32_t FC_cycle_wraps;
+static volatile uint32_t FC_cycle_epoch;
+// the 64-bit cycle count of the last systick
+static uint64_t FC_systick_cycles64;
+
+uint64_t FC_cycle_count()
+{
+    uint32_t epoch = FC_cycle_epoch;
+    uint32_t low = ARM_DWT_CYCCNT;
+    uint32_t high = (epoch >> 1) + ((epoch & 1) & ~(low >> 31));
+    return ((uint64_t)high << 32) | low;
+}
+
+uint64_t FC_time_us()
+{
+    return FC_cycle_count() / (F_CPU_ACTUAL/1000000);
+}
+
+uint64_t FC_time_ns()
+{
+    return FC_cycles_to_ns(FC_cycle_count());
+}
+
+uint64_t FC_cycles_to_ns(uint64_t cycles)
+{
+    return cycles * 1000 / (F_CPU_ACTUAL/1000000);
+}
+
+// update the 64-bit clock, called from the systick ISR
+static inline uint64_t cycle_clock_tick(uint32_t now)
+{
+    // the counter has wrapped around since the last systick
+    if (now < (uint32_t)FC_systick_cycles64) FC_cycle_wraps++;
+    FC_cycle_epoch = (FC_cycle_wraps << 1) | (now >> 31);
+    FC_systick_cycles64 = ((uint64_t)FC_cycle_wraps << 32) | now;
+    return FC_systick_cycles64;
+}
+
 // we use a flag to indicate if it is allowed to call module interrupts
 static volatile bool FC_module_interrupts_active;
 
+// the Teensyduino core has no access to the interrupt mask register
+#ifndef __get_PRIMASK
+static inline uint32_t kernel_get_primask()
+{
+    uint32_t primask;
+    __asm__ volatile("mrs %0, primask" : "=r" (primask));
+    return primask;
+}
+static inline void kernel_set_primask(uint32_t primask)
+{
+    __asm__ volatile("msr primask, %0" : : "r" (primask) : "memory");
+}
+#define __get_PRIMASK() kernel_get_primask()
+#define __set_PRIMASK(primask) kernel_set_primask(primask)
+#endif
+
+// Kernel data are shared with the systick ISR, they are modified with interrupts blocked.
+// The lock returns the previous interrupt mask which is restored by the unlock,
+// so the lock can be taken by a caller that has already blocked interrupts
+// (nested kernel calls, other ISRs) without enabling them too early.
+static inline uint32_t kernel_lock() { uint32_t primask = __get_PRIMASK(); __disable_irq(); return primask; };
+static inline void kernel_unlock(uint32_t primask) { __set_PRIMASK(primask); };
+
 // we record the maximum number of CPU cycles between 2 interrupts
 // (should be about 600000)
 static volatile uint32_t FC_max_isr_spacing;
@@ -55,7 +125,8 @@ static volatile uint32_t FC_max_isr_time_to_completion;
 static Module* FC_max_isr_time_module;
 uint32_t FC_get_max_isr_time_to_completion() { return FC_max_isr_time_to_completion; };
 void FC_reset_max_isr_time_to_completion() { FC_max_isr_time_to_completion=0; };
-std::string FC_max_isr_time_module_ID() { return FC_max_isr_time_module->id; };
+std::string FC_max_isr_time_module_ID()
+    { return (FC_max_isr_time_module != 0) ? FC_max_isr_time_module->id : std::string("--"); };
 
 // we record the longest time it takes to complete a task (in CPU cycles)
 // we can read the latest value or reset it to zero (used by the watchdog)
@@ -64,10 +135,438 @@ static volatile uint32_t FC_max_task_runtime;
 static Module* FC_max_task_runtime_module;
 uint32_t FC_get_max_task_runtime() { return FC_max_task_runtime; };
 void FC_reset_max_task_runtime() { FC_max_task_runtime=0; };
-std::string FC_max_task_runtime_module_ID() { return FC_max_task_runtime_module->id; };
+std::string FC_max_task_runtime_module_ID()
+    { return (FC_max_task_runtime_module != 0) ? FC_max_task_runtime_module->id : std::string("--"); };
+
+void CycleHistogram::clear()
+{
+    for (int i=0; i<HISTOGRAM_BUCKETS; i++) counts[i] = 0;
+    total = 0;
+    max_cycles = 0;
+}
+
+void CycleHistogram::snapshot(CycleHistogram *copy, bool reset)
+{
+    uint32_t irq = kernel_lock();
+    *copy = *this;
+    if (reset) clear();
+    kernel_unlock(irq);
+}
+
+uint32_t CycleHistogram::percentile(float fraction)
+{
+    if (total == 0) return 0;
+    // the rank of the value we are looking for (at least 1)
+    uint32_t rank = (uint32_t)(fraction * total + 0.5);
+    if (rank < 1) rank = 1;
+    uint32_t sum = 0;
+    for (int i=0; i<HISTOGRAM_BUCKETS-1; i++)
+    {
+        sum += counts[i];
+        if (sum >= rank)
+        {
+            uint32_t limit = (i == 0) ? 0 : (1u << i) - 1;
+            return (limit < max_cycles) ? limit : max_cycles;
+        };
+    };
+    return max_cycles;
+}
 
 std::list<Module*> module_list;
-std::list<Task> task_list;
+
+// the registry of all modules, indexed by the module index
+static Module* module_table[KERNEL_MAX_MODULES];
+static uint8_t module_table_count;
+
+uint8_t FC_register_module(Module *mod)
+{
+    if (module_table_count >= KERNEL_MAX_MODULES) return MODULE_INDEX_NONE;
+    module_table[module_table_count] = mod;
+    return module_table_count++;
+}
+
+void FC_unregister_module(uint8_t index)
+{
+    if (index < KERNEL_MAX_MODULES) module_table[index] = 0;
+}
+
+Module* FC_module(uint8_t index)
+{
+    return (index < module_table_count) ? module_table[index] : 0;
+}
+
+uint8_t FC_num_modules() { return module_table_count; };
+
+// the table of interned names, the handle is the index into the table
+// handle 0 is reserved for names that could not be interned
+static const char* name_table[KERNEL_MAX_NAMES] = { "" };
+static volatile uint16_t name_table_count = 1;
+
+// search the table entries from the given handle on
+static uint16_t find_name(const char* name, uint16_t from)
+{
+    for (uint16_t h=from; h<name_table_count; h++)
+        if (strcmp(name_table[h], name) == 0) return h;
+    return NAME_HANDLE_NONE;
+}
+
+uint16_t FC_name_handle(const char* name)
+{
+    uint16_t count = name_table_count;
+    uint16_t h = find_name(name, 1);
+    if (h != NAME_HANDLE_NONE) return h;
+    // this is done only once per name, the copy stays for the lifetime of the system
+    char *copy = strdup(name);
+    uint32_t irq = kernel_lock();
+    // the name may have been added in the meantime
+    h = find_name(name, count);
+    if ((h == NAME_HANDLE_NONE) and (name_table_count < KERNEL_MAX_NAMES))
+    {
+        name_table[name_table_count] = copy;
+        h = name_table_count++;
+        copy = 0;
+    };
+    kernel_unlock(irq);
+    free(copy);
+    return h;
+}
+
+const char* FC_name(uint16_t handle)
+{
+    return (handle < name_table_count) ? name_table[handle] : "";
+}
+
+// the trace ring buffer
+// trace_head counts all events ever written, the slot is trace_head & (KERNEL_TRACE_EVENTS-1)
+#if KERNEL_TRACE
+static TraceEvent trace_buffer[KERNEL_TRACE_EVENTS];
+#endif
+static std::atomic<uint32_t> trace_head(0);
+static volatile bool trace_frozen;
+
+static_assert((KERNEL_TRACE_EVENTS & (KERNEL_TRACE_EVENTS-1)) == 0,
+    "KERNEL_TRACE_EVENTS has to be a power of 2");
+
+#if KERNEL_TRACE
+void FC_trace_event(uint8_t type, uint8_t module, uint16_t arg)
+{
+    if (trace_frozen) return;
+    // The slot is claimed without taking the kernel lock, so events can be
+    // recorded from within kernel code holding the lock and from any ISR.
+    // An interrupt between reading the clock and claiming the slot can
+    // swap the order of two events (see test/trace_to_chrome.py).
+    uint32_t cycles = ARM_DWT_CYCCNT;
+    uint32_t slot = trace_head.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent *ev = &trace_buffer[slot & (KERNEL_TRACE_EVENTS-1)];
+    ev->cycles = cycles;
+    ev->type = type;
+    ev->module = module;
+    ev->arg = arg;
+}
+#endif
+
+void FC_trace_freeze(bool frozen) { trace_frozen = frozen; };
+
+uint32_t FC_trace_count()
+{
+#if KERNEL_TRACE
+    uint32_t head = trace_head.load(std::memory_order_relaxed);
+    return (head < KERNEL_TRACE_EVENTS) ? head : KERNEL_TRACE_EVENTS;
+#else
+    return 0;
+#endif
+}
+
+uint32_t FC_trace_read(TraceEvent *dest, uint32_t first, uint32_t max)
+{
+    uint32_t n = 0;
+#if KERNEL_TRACE
+    uint32_t available = FC_trace_count();
+    uint32_t oldest = trace_head.load(std::memory_order_relaxed) - available;
+    while ((first+n < available) and (n < max))
+    {
+        dest[n] = trace_buffer[(oldest+first+n) & (KERNEL_TRACE_EVENTS-1)];
+        n++;
+    };
+#endif
+    return n;
+}
+
+// the modules whose interrupt() is called with every systick
+// this is filled from module_list when the module interrupts are activated
+static Module* interrupt_modules[KERNEL_MAX_INTERRUPT_MODULES];
+static volatile int num_interrupt_modules;
+
+// all tasks that have been scheduled for execution
+static TaskQueue task_queue;
+
+uint16_t FC_get_task_queue_high_water() { return task_queue.high_water(); };
+void FC_reset_task_queue_high_water() { task_queue.reset_high_water(); };
+uint32_t FC_get_task_queue_rejected() { return task_queue.rejected(); };
+void FC_reset_task_queue_rejected() { task_queue.reset_rejected(); };
+
+TaskQueue::TaskQueue()
+{
+#if KERNEL_EDF_SCHEDULING
+    next_sequence = 0;
+#else
+    for (int level=0; level<TASK_PRIORITY_LEVELS; level++)
+    {
+        head[level] = 0;
+        tail[level] = 0;
+    };
+#endif
+    count = 0;
+    max_count = 0;
+    reject_count = 0;
+}
+
+#if KERNEL_EDF_SCHEDULING
+// tasks with the same deadline keep the order in which they were inserted
+// (the sequence numbers are compared wrap-around safe)
+static inline bool earlier(const Task &a, const Task &b)
+{
+    if (a.deadline != b.deadline) return a.deadline < b.deadline;
+    return (int32_t)(a.sequence - b.sequence) < 0;
+}
+#endif
+
+bool TaskQueue::push(Task task, uint8_t priority, bool coalesce)
+{
+    if (priority >= TASK_PRIORITY_LEVELS) priority = TASK_PRIORITY_LEVELS-1;
+    bool ok = false;
+    uint32_t irq = kernel_lock();
+    task.pending = -1;
+    if (coalesce)
+    {
+        Module *mod = task.module;
+        for (int8_t i=0; i<MODULE_MAX_PENDING_TASKS; i++)
+        {
+            if (mod->pending_tasks_[i] == task.funct)
+            {
+                // this task is already waiting in the queue
+                mod->tasks_coalesced_++;
+                kernel_unlock(irq);
+                return true;
+            };
+            if ((task.pending < 0) and !mod->pending_tasks_[i].valid())
+                task.pending = i;
+        };
+    };
+#if KERNEL_EDF_SCHEDULING
+    if (count < TASK_PRIORITY_LEVELS*TASK_QUEUE_CAPACITY)
+    {
+        // if the pending table of the module is full the task is just not tracked
+        if (task.pending >= 0)
+            task.module->pending_tasks_[task.pending] = task.funct;
+        task.sequence = next_sequence++;
+        // sift up from the end of the heap
+        uint16_t i = count;
+        while (i > 0)
+        {
+            uint16_t parent = (i-1)/2;
+            if (!earlier(task, heap[parent])) break;
+            heap[i] = heap[parent];
+            i = parent;
+        };
+        heap[i] = task;
+        count++;
+#else
+    // the difference automatically wraps around
+    if ((uint16_t)(head[priority]-tail[priority]) < TASK_QUEUE_CAPACITY)
+    {
+        // if the pending table of the module is full the task is just not tracked
+        if (task.pending >= 0)
+            task.module->pending_tasks_[task.pending] = task.funct;
+        slots[priority][head[priority] & (TASK_QUEUE_CAPACITY-1)] = task;
+        head[priority]++;
+        count++;
+#endif
+        if (count > max_count) max_count = count;
+        FC_TRACE(TRACE_TASK_ENQUEUE, task.module->index(), count);
+        ok = true;
+    }
+    else
+        reject_count++;
+    kernel_unlock(irq);
+    return ok;
+}
+
+bool TaskQueue::pop(Task *task)
+{
+    // nothing to do - this is the idle case, so we don't need the lock
+    if (count == 0) return false;
+    bool ok = false;
+    uint32_t irq = kernel_lock();
+#if KERNEL_EDF_SCHEDULING
+    if (count > 0)
+    {
+        *task = heap[0];
+        count--;
+        // sift the last task down from the top of the heap
+        Task last = heap[count];
+        uint16_t i = 0;
+        while (true)
+        {
+            uint16_t child = 2*i+1;
+            if (child >= count) break;
+            if ((child+1 < count) and earlier(heap[child+1], heap[child])) child++;
+            if (!earlier(heap[child], last)) break;
+            heap[i] = heap[child];
+            i = child;
+        };
+        heap[i] = last;
+        ok = true;
+    };
+#else
+    for (int level=0; level<TASK_PRIORITY_LEVELS; level++)
+    {
+        if (head[level] != tail[level])
+        {
+            *task = slots[level][tail[level] & (TASK_QUEUE_CAPACITY-1)];
+            tail[level]++;
+            count--;
+            ok = true;
+            break;
+        };
+    };
+#endif
+    // from now on the task can be scheduled again
+    // a request arriving while it is running will be executed afterwards
+    if (ok and (task->pending >= 0))
+        task->module->pending_tasks_[task->pending] = TaskDelegate();
+    kernel_unlock(irq);
+    return ok;
+}
+
+// a timer of the kernel timing wheel
+struct Timer
+{
+    Module*     module;
+    TaskFunct   funct;
+    // the time (FC_time_now) when the timer expires next
+    uint32_t    expires;
+    // zero for a one-shot timer
+    uint32_t    period;
+    // the next timer in the same wheel slot
+    uint8_t     next;
+    // if the timer is in use
+    bool        active;
+};
+
+// Timers are linked by their index+1, zero marks the end of a list.
+// This way all tables are valid when zero-initialized and timers can
+// be registered even before setup_core_system() has been called.
+static Timer timers[KERNEL_MAX_TIMERS];
+// the first timer in each slot of the wheel
+static uint8_t timer_wheel[TIMER_WHEEL_SLOTS];
+
+static_assert(KERNEL_MAX_TIMERS < 256, "timers are linked by uint8_t");
+
+// insert a timer into the slot of its expiration time
+// this has to be called with the kernel lock held
+static void timer_insert(int id)
+{
+    uint8_t *slot = &timer_wheel[timers[id].expires & (TIMER_WHEEL_SLOTS-1)];
+    timers[id].next = *slot;
+    *slot = id+1;
+}
+
+// remove a timer from the wheel
+// this has to be called with the kernel lock held
+static void timer_remove(int id)
+{
+    uint8_t *link = &timer_wheel[timers[id].expires & (TIMER_WHEEL_SLOTS-1)];
+    while (*link != 0)
+    {
+        if (*link == id+1)
+        {
+            *link = timers[id].next;
+            break;
+        };
+        link = &timers[*link-1].next;
+    };
+}
+
+// schedule all tasks for timers expiring now
+// this is called from the systick ISR
+static void timer_tick(uint32_t now)
+{
+    uint8_t *link = &timer_wheel[now & (TIMER_WHEEL_SLOTS-1)];
+    while (*link != 0)
+    {
+        int id = *link-1;
+        Timer *t = &timers[id];
+        if (t->expires == now)
+        {
+            // unlink, the next timer moves into this position
+            *link = t->next;
+            schedule_task(t->module, t->funct);
+            if (t->period > 0)
+            {
+                t->expires += t->period;
+                timer_insert(id);
+            }
+            else
+                t->active = false;
+        }
+        else
+            link = &t->next;
+    };
+}
+
+static int timer_start(Module *mod, TaskFunct f, uint32_t expires, uint32_t period)
+{
+    int id = -1;
+    uint32_t irq = kernel_lock();
+    for (int i=0; i<KERNEL_MAX_TIMERS; i++)
+        if (!timers[i].active)
+        {
+            id = i;
+            break;
+        };
+    if (id >= 0)
+    {
+        timers[id].module = mod;
+        timers[id].funct = f;
+        timers[id].expires = expires;
+        timers[id].period = period;
+        timers[id].active = true;
+        timer_insert(id);
+    };
+    kernel_unlock(irq);
+    return id;
+}
+
+int schedule_periodic_task(Module *mod, TaskFunct f, uint32_t period_ms, uint32_t phase_ms)
+{
+    if (period_ms == 0) return -1;
+    // the next time after now with (time % period) == phase
+    uint32_t now = FC_systick_millis_count;
+    uint32_t expires = now - now % period_ms + phase_ms % period_ms;
+    if ((int32_t)(expires - now) <= 0) expires += period_ms;
+    return timer_start(mod, f, expires, period_ms);
+}
+
+int schedule_delayed_task(Module *mod, TaskFunct f, uint32_t delay_ms)
+{
+    // the timer can expire with the next systick at the earliest
+    if (delay_ms == 0) delay_ms = 1;
+    return timer_start(mod, f, FC_systick_millis_count + delay_ms, 0);
+}
+
+void cancel_timer(Module *mod, int timer_id)
+{
+    if ((timer_id < 0) or (timer_id >= KERNEL_MAX_TIMERS)) return;
+    uint32_t irq = kernel_lock();
+    // the slot may have been given to a timer of another module
+    if (timers[timer_id].active and (timers[timer_id].module == mod))
+    {
+        timer_remove(timer_id);
+        timers[timer_id].active = false;
+    };
+    kernel_unlock(irq);
+}
 
 // we use our own ISR for the systick interrupt
 // it is copied from EventResponder.cpp (previously delay.c)
@@ -81,27 +580,36 @@ void FC_systick_isr(void)
     systick_cycle_count = ARM_DWT_CYCCNT;
     systick_millis_count++;
     // --- end original code
-    uint32_t last_count = FC_systick_cycle_count;
+    FC_TRACE(TRACE_ISR_ENTER, MODULE_INDEX_NONE, 0);
+    uint64_t last_count = FC_systick_cycles64;
     FC_systick_cycle_count = ARM_DWT_CYCCNT;
+    uint64_t this_count = cycle_clock_tick(FC_systick_cycle_count);
     FC_systick_millis_count++;
     // keep track of potentially delayed interrupts
-    uint32_t spacing = FC_systick_cycle_count-last_count;
+    uint32_t spacing = FC_cycles_between(last_count, this_count);
     if (spacing > FC_max_isr_spacing) FC_max_isr_spacing=spacing;
+    // schedule the tasks of all expired timers
+    // the timers run from the start, their tasks are only executed
+    // when the main loop has been entered
+    timer_tick(FC_systick_millis_count);
     // call all module interrupts - record timing
-    std::list<Module*>::iterator it;
-    // TODO: this should be only enabled by a flag that is initially disabled
-    // calling the module interrups should only be enabled when all setup is complete
+    // only modules that need it are called, all others are triggered
+    // by their timers or by messages arriving at their ports
+    // calling the module interrups is only enabled when all setup is complete
     if (FC_module_interrupts_active)
-		for (it = module_list.begin(); it != module_list.end(); it++)
+		for (int i=0; i<num_interrupt_modules; i++)
 		{
-		    Module* mod = *it;
+		    Module* mod = interrupt_modules[i];
 		    // we check timing for every module call
+		    FC_TRACE(TRACE_INTERRUPT_ENTER, mod->index(), 0);
 		    uint32_t isr_start = ARM_DWT_CYCCNT;
 		    // call the modules interrupt procedure
 		    mod->interrupt();
 		    uint32_t isr_stop = ARM_DWT_CYCCNT;
+		    FC_TRACE(TRACE_INTERRUPT_EXIT, mod->index(), 0);
 		    // the difference automaticall wraps around
 		    uint32_t cycles = isr_stop - isr_start;
+		    mod->isr_time_histogram.record(cycles);
 		    // the worst module ist stored for reporting by the watchdog
 		    // the watchdog periodically resets the max value to 0
 		    if (cycles>FC_max_isr_time_to_completion)
@@ -113,12 +621,14 @@ void FC_systick_isr(void)
     // record the total time the interrupt took
     uint32_t isr_duration = ARM_DWT_CYCCNT - FC_systick_cycle_count;
     if (isr_duration>FC_max_isr_duration) FC_max_isr_duration=isr_duration;
+    FC_TRACE(TRACE_ISR_EXIT, MODULE_INDEX_NONE, 0);
 }
 
 void setup_core_system()
 {
     FC_systick_millis_count = 0;
     FC_systick_cycle_count = ARM_DWT_CYCCNT;
+    cycle_clock_tick(FC_systick_cycle_count);
     FC_max_isr_spacing = 0;
     FC_max_isr_time_to_completion = 0;
     FC_module_interrupts_active = false;
@@ -128,17 +638,101 @@ void setup_core_system()
 
 void FC_module_interrupts_activate()
 {
+    int n = 0;
+    for (Module* mod : module_list)
+        if (mod->uses_interrupt() and (n < KERNEL_MAX_INTERRUPT_MODULES))
+            interrupt_modules[n++] = mod;
+    num_interrupt_modules = n;
     FC_module_interrupts_active = true;
 }
 
-void schedule_task(Module *mod, TaskFunct f)
+// the cycle count by which a task requested now should have been started
+static inline uint64_t task_deadline(uint64_t request_time, uint32_t deadline_us)
+{
+    return request_time + (uint64_t)deadline_us * (F_CPU_ACTUAL/1000000);
+}
+
+bool schedule_task(Module *mod, TaskFunct f)
+{
+    return schedule_task(mod, f, mod->task_priority(), mod->task_deadline());
+}
+
+bool schedule_task(Module *mod, TaskFunct f, uint8_t priority)
+{
+    return schedule_task(mod, f, priority, task_default_deadline(priority));
+}
+
+bool schedule_task(Module *mod, TaskFunct f, uint8_t priority, uint32_t deadline_us)
+{
+    uint64_t now = FC_cycle_count();
+    Task task = {
+        .module = mod,
+        .request_time = now,
+        .deadline = task_deadline(now, deadline_us),
+        .funct = f,
+        .pending = -1
+        };
+    return task_queue.push(task, priority);
+}
+
+// the storage for std::function objects of the compatibility path
+// a bit is set in legacy_used for every occupied slot
+static std::function<void ()> legacy_funct[TASK_LEGACY_SLOTS];
+static volatile uint32_t legacy_used;
+
+static_assert(TASK_LEGACY_SLOTS <= 32, "legacy slots are managed by a 32-bit mask");
+
+static void legacy_thunk(void *slot)
+{
+    std::function<void ()> *f = static_cast<std::function<void ()>*>(slot);
+    (*f)();
+    // release any storage held by the function object before freeing the slot
+    *f = nullptr;
+    uint32_t mask = 1u << (f - legacy_funct);
+    uint32_t irq = kernel_lock();
+    legacy_used &= ~mask;
+    kernel_unlock(irq);
+}
+
+bool schedule_task(Module *mod, std::function<void ()> f)
+{
+    return schedule_task(mod, f, mod->task_priority());
+}
+
+bool schedule_task(Module *mod, std::function<void ()> f, uint8_t priority)
 {
+    uint32_t irq = kernel_lock();
+    uint32_t free_slots = ~legacy_used;
+#if TASK_LEGACY_SLOTS < 32
+    free_slots &= (1u << TASK_LEGACY_SLOTS) - 1;
+#endif
+    if (free_slots == 0)
+    {
+        // the rejection is counted like a full task queue
+        task_queue.count_rejected();
+        kernel_unlock(irq);
+        return false;
+    };
+    int n = __builtin_ctz(free_slots);
+    legacy_used |= 1u << n;
+    kernel_unlock(irq);
+    legacy_funct[n] = f;
+    uint64_t now = FC_cycle_count();
     Task task = {
         .module = mod,
-        .request_time = ARM_DWT_CYCCNT,
-        .funct = f
+        .request_time = now,
+        .deadline = task_deadline(now, task_default_deadline(priority)),
+        .funct = TaskDelegate(&legacy_funct[n], &legacy_thunk),
+        .pending = -1
         };
-    task_list.push_back(task);
+    if (task_queue.push(task, priority, false))
+        return true;
+    // the task queue was full - release the slot again
+    legacy_funct[n] = nullptr;
+    irq = kernel_lock();
+    legacy_used &= ~(1u << n);
+    kernel_unlock(irq);
+    return false;
 }
 
 void kernel_loop()
@@ -172,33 +766,39 @@ void kernel_loop()
 
 
 	    // TASKMANAGER:
-	    // All scheduled tasks get executed based on priority (list position).
-	    // It should be guaranteed that any scheduled task is executed within 10 ms.
+	    // All scheduled tasks get executed based on priority (queue level and position)
+	    // or with KERNEL_EDF_SCHEDULING in the order of their deadlines.
+	    // Every task should be started by its deadline (by default within 10 ms).
         // No task should run longer than 5ms.
         // Both constraints are not actively inforced, but any violations are reported.
         
-        if (task_list.empty())
+        Task task;
+        if (!task_queue.pop(&task))
         {
             // this is a busy wait for 10us determined by the number of CPU cycles elapsed
             delayMicroseconds(10);
         }
         else
         {
-            // get the first entry in the task list
-            Task task = task_list.front();
-            // remove it from the list
-            task_list.pop_front();
             // check how much time has elapsed from the request of the task
-            uint32_t start_delay = ARM_DWT_CYCCNT-task.request_time;
+            uint64_t now = FC_cycle_count();
+            uint32_t start_delay = FC_cycles_between(task.request_time, now);
             // the max is reset when the watchdog checks it
             if (start_delay>FC_max_task_delay) FC_max_task_delay=start_delay;
+            task.module->task_delay_histogram.record(start_delay);
+            // tasks started late are counted for their module
+            if (now > task.deadline)
+                task.module->deadline_misses_++;
 
             // execute the task
+            FC_TRACE(TRACE_TASK_START, task.module->index(), task_queue.depth());
             uint32_t start = ARM_DWT_CYCCNT;
             task.funct();
             uint32_t stop = ARM_DWT_CYCCNT;
+            FC_TRACE(TRACE_TASK_STOP, task.module->index(), 0);
             // the difference automaticall wraps around
             uint32_t runtime = stop - start;
+            task.module->task_runtime_histogram.record(runtime);
             // check the runtime of the task
             if (runtime>FC_max_task_runtime)
             {
@@ -5,19 +5,27 @@
     It handles a list of modules which comprise the application system.
     
     The systick interrupt routine is called every millisecond
-    and it in turn calls the interrupt() routine of all modules listed.
+    and it in turn calls the interrupt() routine of all modules listed
+    that need it (mostly for polling hardware). All other modules get their
+    tasks scheduled by kernel timers or when messages arrive at their ports.
     This interrupt routine should only perform minimal work and
     typically return within a few microseconds.
     Time critical work can be done right here, as long as the time constraints are kept.
     The total time needed for the completion of the interrupt routine is monitored.
     
-    Within the core we mangage a task list.
+    Within the core we mangage a task queue.
     This is intended for all work that may take longer than a few microseconds.
-    Every module via its interrupt routine can insert tasks into that list.
-    A task consists of a pointer to a static method of the module
+    Every module via its interrupt routine can insert tasks into that queue.
+    A task consists of a delegate calling a method of the module
     that takes no parameters and returns no values. It only acts on
     the internal state of the module (but could send messages for instance).
-    This task list is sequentially processed by the main program.
+    The task queue has a few priority levels and a fixed capacity,
+    so scheduling a task never allocates memory.
+    It is processed by the main program, always taking the oldest task
+    of the highest priority level that has pending tasks.
+    Alternatively, the kernel can be built for earliest-deadline-first
+    dispatching (see KERNEL_EDF_SCHEDULING below). Then every task carries
+    a deadline and the pending task with the nearest deadline is executed first.
     
     TODO:
         - remove dynamic variables (e.g. String)
@@ -30,6 +38,7 @@
 #include <list>
 #include <functional>
 #include <string>
+#include <type_traits>
 
 class Module;
 
@@ -40,6 +49,28 @@ uint32_t FC_time_now();
 // if current FC_systick_millis_count is small than timestamp wrap-around
 uint32_t FC_elapsed_millis(uint32_t timestamp);
 
+// The 32-bit CPU cycle counter (ARM_DWT_CYCCNT) wraps around every 7.16 s at 600 MHz.
+// The kernel extends it to a monotonic 64-bit clock. The systick ISR stores the
+// upper word together with the top bit of the counter; from that and the current
+// counter value the full count is obtained without any locking (two loads).
+// This can be used from interrupt and task context alike, the only condition
+// being that the systick is not blocked for more than 3.5 s.
+uint64_t FC_cycle_count();
+
+// the same in microseconds and nanoseconds since the cycle counter was started
+uint64_t FC_time_us();
+uint64_t FC_time_ns();
+
+// convert a cycle count into nanoseconds
+uint64_t FC_cycles_to_ns(uint64_t cycles);
+
+// a difference of two 64-bit cycle counts limited to 32 bit (for the statistics)
+inline uint32_t FC_cycles_between(uint64_t start, uint64_t stop)
+{
+    uint64_t diff = stop - start;
+    return (diff > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)diff;
+}
+
 // we record the maximum number of CPU cycles between 2 interrupts
 // (should be about 600000)
 // we can read the latest value or reset it to zero (used by the watchdog)
@@ -65,6 +96,16 @@ uint32_t FC_get_max_isr_time_to_completion();
 void FC_reset_max_isr_time_to_completion();
 std::string FC_max_isr_time_module_ID();
 
+// we record the largest number of tasks waiting in the task queue
+// we can read the latest value or reset it to zero (used by the watchdog)
+uint16_t FC_get_task_queue_high_water();
+void FC_reset_task_queue_high_water();
+
+// we count the tasks that could not be scheduled because the queue was full
+// we can read the latest value or reset it to zero (used by the watchdog)
+uint32_t FC_get_task_queue_rejected();
+void FC_reset_task_queue_rejected();
+
 // we record the longest time it takes to complete a task (in CPU cycles)
 // we can read the latest value or reset it to zero (used by the watchdog)
 // the identifier of the slowest module is stored
@@ -72,38 +113,385 @@ uint32_t FC_get_max_task_runtime();
 void FC_reset_max_task_runtime();
 std::string FC_max_task_runtime_module_ID();
 
+/*
+    A histogram of CPU cycle counts with logarithmic buckets.
+    Bucket 0 counts zero cycles, bucket n counts values from 2^(n-1) to 2^n-1.
+    The last bucket also takes all larger values.
+    Recording a value is O(1) and never allocates memory.
+    
+    Every module has histograms of its ISR time, task runtime and
+    task start delay which are recorded by the kernel.
+    As values are recorded from the systick interrupt, a consistent
+    copy has to be taken with snapshot() before evaluating a histogram.
+*/
+#define HISTOGRAM_BUCKETS 32
+
+class CycleHistogram
+{
+
+public:
+
+    CycleHistogram() { clear(); };
+
+    void clear();
+
+    // add one value
+    void record(uint32_t cycles)
+    {
+        uint8_t bucket = (cycles == 0) ? 0 : 32 - __builtin_clz(cycles);
+        if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS-1;
+        counts[bucket]++;
+        total++;
+        if (cycles > max_cycles) max_cycles = cycles;
+    };
+
+    // copy the histogram with the systick interrupt blocked
+    // if reset is set, the histogram is cleared afterwards
+    void snapshot(CycleHistogram *copy, bool reset = false);
+
+    // the number of values recorded
+    uint32_t count() { return total; };
+
+    // the largest value recorded
+    uint32_t max() { return max_cycles; };
+
+    // the value below which the given fraction (0.0 ... 1.0) of all values lie
+    // this is the upper limit of the bucket containing that percentile
+    // (never more than the maximum value recorded)
+    uint32_t percentile(float fraction);
+
+private:
+
+    uint32_t counts[HISTOGRAM_BUCKETS];
+    uint32_t total;
+    uint32_t max_cycles;
+
+};
+
 // Here are the main initializations that are needed to access the processor hardware.
 // 1) bend the interrupt vector to our own ISR
 void setup_core_system();
 
 // When initially started, our systick interrupt does not call module interrupts
 // After initializing all of the system, the module interrupts can be activated using this function.
+// All modules in module_list that use an interrupt are collected at this time.
+#define KERNEL_MAX_INTERRUPT_MODULES 32
 void FC_module_interrupts_activate();
 
+/*
+    Tasks are scheduled with one of a few priority levels.
+    Lower numbers are executed first. Within one level tasks are executed
+    in the sequence they have been scheduled.
+*/
+#define TASK_PRIORITY_CONTROL       0   // sensor readout and actuators of the control loops
+#define TASK_PRIORITY_IO            1   // communication, message handling, logging
+#define TASK_PRIORITY_HOUSEKEEPING  2   // display, status reports, everything that can wait
+#define TASK_PRIORITY_LEVELS        3
+
+/*
+    Every task gets a deadline by which its execution should have started.
+    It is given in microseconds relative to the time of the request.
+    Unless explicitly given it is the default deadline of the module,
+    which (unless set by the module) depends on its task priority.
+    Tasks starting after their deadline are counted per module
+    as deadline misses (reported by the watchdog).
+*/
+#define TASK_DEADLINE_CONTROL_US        1000
+#define TASK_DEADLINE_IO_US             10000
+#define TASK_DEADLINE_HOUSEKEEPING_US   100000
+
+inline uint32_t task_default_deadline(uint8_t priority)
+{
+    if (priority == TASK_PRIORITY_CONTROL) return TASK_DEADLINE_CONTROL_US;
+    if (priority == TASK_PRIORITY_IO) return TASK_DEADLINE_IO_US;
+    return TASK_DEADLINE_HOUSEKEEPING_US;
+}
+
+/*
+    If set to 1 the task queue is ordered by the task deadlines
+    (earliest deadline first) instead of the priority levels.
+    The priority then only determines the default deadline of a module.
+    This way the tasks of the control loops run ahead of logging
+    and housekeeping without any hand-ordering of modules or levels.
+*/
+#ifndef KERNEL_EDF_SCHEDULING
+#define KERNEL_EDF_SCHEDULING 0
+#endif
+
+// the number of tasks that can be pending per priority level
+// this has to be a power of 2
+// (with EDF scheduling all levels share one queue of the total size)
+#define TASK_QUEUE_CAPACITY 32
+
+/*
+    A task delegate is the entry point of a task.
+    It refers to a member function of a module taking no parameters
+    and returning nothing. It consists of just the object pointer and
+    a pointer to a static thunk function that calls the member function.
+    In contrast to std::function it never allocates memory and can be
+    copied as plain data.
+    
+    A delegate is created like this :
+        TaskDelegate::create<Logger, &Logger::run>(this)
+*/
+class TaskDelegate
+{
+
+public:
+
+    typedef void (*Thunk)(void *object);
+    
+    TaskDelegate() : object(0), thunk(0) {};
+    TaskDelegate(void *obj, Thunk th) : object(obj), thunk(th) {};
+    
+    template <class T, void (T::*method)()>
+    static TaskDelegate create(T *obj)
+    {
+        return TaskDelegate(obj, &call<T, method>);
+    };
+    
+    // execute the member function
+    void operator()() const { thunk(object); };
+    
+    // a default constructed delegate does not refer to any function
+    bool valid() const { return thunk != 0; };
+    
+    bool operator==(const TaskDelegate &other) const
+        { return (object == other.object) and (thunk == other.thunk); };
+    
+private:
+
+    template <class T, void (T::*method)()>
+    static void call(void *obj) { (static_cast<T*>(obj)->*method)(); };
+    
+    void    *object;
+    Thunk   thunk;
+    
+};
+
+static_assert(sizeof(TaskDelegate) <= 2*sizeof(void*),
+    "TaskDelegate must fit into two machine words");
+static_assert(std::is_trivially_copyable<TaskDelegate>::value,
+    "TaskDelegate must be trivially copyable");
+
 /*
     This is a task descriptor
-    TODO: this needs extensions: priority, maybe different entry points
+    TODO: maybe different entry points
 */
-typedef std::function<void ()> TaskFunct;
+typedef TaskDelegate TaskFunct;
 struct Task 
 {
     // the module which has started this task
     Module* module;
-    // the CPU cycle when the task has bee requested
-    uint32_t request_time;
+    // the CPU cycle when the task has bee requested (see FC_cycle_count())
+    uint64_t request_time;
+    // the CPU cycle by which the task should have been started
+    uint64_t deadline;
     // a pointer to the procedure to be executed
     TaskFunct funct;
+    // the entry in the pending table of the module (-1 if not tracked)
+    int8_t pending;
+    // the order of insertion into the task queue,
+    // tasks with the same deadline are run in this order (EDF scheduling)
+    uint32_t sequence;
+};
+
+/*
+    This is the queue of all tasks that have been scheduled for execution.
+    For every priority level there is a ring buffer of fixed size,
+    so there is no memory allocation when scheduling a task.
+    With KERNEL_EDF_SCHEDULING the tasks are kept in a binary heap
+    ordered by their deadline instead.
+    A task that is requested again while it is still waiting in the queue
+    is not inserted a second time (the request is coalesced and counted
+    by the module). So the queue holds at most one copy of every entry point.
+    Tasks are inserted from the systick interrupt (or task context)
+    and removed by the main loop. Both operations are O(1)
+    (O(log n) with EDF scheduling).
+*/
+class TaskQueue
+{
+
+public:
+
+    TaskQueue();
+
+    // Insert a task with the given priority.
+    // It returns false (and counts the rejection) if that level is full.
+    // If coalesce is set and the same task of the module is already pending
+    // nothing is inserted (this counts as success).
+    // With EDF scheduling the priority is ignored.
+    bool push(Task task, uint8_t priority, bool coalesce = true);
+
+    // Remove the oldest task of the highest priority level
+    // (with EDF scheduling the task with the nearest deadline)
+    // into the given descriptor.
+    // It returns false if the queue is empty.
+    bool pop(Task *task);
+
+    // the total number of pending tasks
+    uint16_t depth() { return count; };
+
+    // statistics (see FC_get_task_queue_xxx)
+    uint16_t high_water() { return max_count; };
+    void reset_high_water() { max_count = count; };
+    uint32_t rejected() { return reject_count; };
+    void reset_rejected() { reject_count = 0; };
+    void count_rejected() { reject_count++; };
+
+private:
+
+#if KERNEL_EDF_SCHEDULING
+    // a binary heap, the task with the earliest deadline is at heap[0]
+    Task heap[TASK_PRIORITY_LEVELS*TASK_QUEUE_CAPACITY];
+    // the sequence number given to the next task inserted
+    uint32_t next_sequence;
+#else
+    Task slots[TASK_PRIORITY_LEVELS][TASK_QUEUE_CAPACITY];
+    // free-running indices, the slot is index & (TASK_QUEUE_CAPACITY-1)
+    // head is the next slot to be written, tail the next slot to be read
+    uint16_t head[TASK_PRIORITY_LEVELS];
+    uint16_t tail[TASK_PRIORITY_LEVELS];
+#endif
+    volatile uint16_t count;
+    volatile uint16_t max_count;
+    volatile uint32_t reject_count;
+
 };
 
 // all modules are registered in a list
 extern std::list<Module*> module_list;
 
-// all tasks that have been scheduled for execution
-extern std::list<Task> task_list;
+// Every module gets a small index number when it is created.
+// It is used to identify the module in compact data like the trace events.
+// All indices are given out in sequence, a module that cannot be registered
+// because the table is full gets MODULE_INDEX_NONE.
+#define KERNEL_MAX_MODULES 64
+#define MODULE_INDEX_NONE 255
+uint8_t FC_register_module(Module *mod);
+void FC_unregister_module(uint8_t index);
+// the module registered with the given index (0 if there is none)
+Module* FC_module(uint8_t index);
+// the number of indices given out so far
+uint8_t FC_num_modules();
+
+// The names of all senders of messages (usually module names) are kept
+// in a table. Messages only carry the 16-bit handle of the name,
+// the name is looked up when a message is formatted as text or serialized.
+// Interning the same name again returns the same handle. Every module
+// interns its id when it is created, see Module::handle().
+// If the table is full, names get NAME_HANDLE_NONE which reads as an empty name.
+#define KERNEL_MAX_NAMES 128
+#define NAME_HANDLE_NONE 0
+uint16_t FC_name_handle(const char* name);
+// the name of the given handle (never a null pointer)
+const char* FC_name(uint16_t handle);
+
+/*
+    The kernel can record a trace of all its activities
+    (systick interrupts, module interrupt calls, task scheduling and execution,
+    messages received by ports) into a static ring buffer.
+    Every event is stored with the CPU cycle count and the index of the module.
+    The trace can be written to the SD card (see TraceFileWriter) and converted
+    on the host to the Chrome trace format (test/trace_to_chrome.py).
+    
+    Tracing has to be enabled at compile time by defining KERNEL_TRACE=1
+    (see Makefile). Otherwise all trace points compile to nothing.
+*/
+#ifndef KERNEL_TRACE
+#define KERNEL_TRACE 0
+#endif
+
+// the number of events kept in the ring buffer (has to be a power of 2)
+#define KERNEL_TRACE_EVENTS 2048
+
+#define TRACE_ISR_ENTER         1   // arg : -
+#define TRACE_ISR_EXIT          2   // arg : -
+#define TRACE_INTERRUPT_ENTER   3   // arg : -
+#define TRACE_INTERRUPT_EXIT    4   // arg : -
+#define TRACE_TASK_ENQUEUE      5   // arg : the number of pending tasks
+#define TRACE_TASK_START        6   // arg : the number of pending tasks
+#define TRACE_TASK_STOP         7   // arg : -
+#define TRACE_PORT_RECEIVE      8   // arg : the number of entries waiting in the port
+
+struct TraceEvent
+{
+    uint32_t cycles;
+    uint8_t type;
+    uint8_t module;
+    uint16_t arg;
+};
+
+static_assert(sizeof(TraceEvent) == 8, "trace events are stored as 8 bytes");
+
+#if KERNEL_TRACE
+void FC_trace_event(uint8_t type, uint8_t module, uint16_t arg);
+#define FC_TRACE(type, module, arg) FC_trace_event(type, module, arg)
+#else
+#define FC_TRACE(type, module, arg)
+#endif
+
+// While the trace is frozen no events are recorded. This is used while the
+// buffer is read out. The trace can be frozen even if it is not compiled in.
+void FC_trace_freeze(bool frozen);
+
+// the number of events available in the buffer
+uint32_t FC_trace_count();
+
+// Copy events from the buffer, starting with the n-th oldest one.
+// It returns the number of events copied.
+uint32_t FC_trace_read(TraceEvent *dest, uint32_t first, uint32_t max);
 
 // this function can be called by the interrupt routine of any module
 // to request one of the module functions to be scheduled for execution
-void schedule_task(Module *mod, TaskFunct f);
+// it is queued with the default priority and deadline of the module
+// if the same function of the module is already waiting in the queue
+// it will not be scheduled a second time
+// false is returned if the task queue is full and the task has been dropped
+bool schedule_task(Module *mod, TaskFunct f);
+
+// the same with an explicitly given priority level
+// the deadline is the default one of that level
+bool schedule_task(Module *mod, TaskFunct f, uint8_t priority);
+
+// the same with an explicitly given priority level and deadline (in us from now)
+bool schedule_task(Module *mod, TaskFunct f, uint8_t priority, uint32_t deadline_us);
+
+// Compatibility path for modules that still schedule std::function objects
+// (e.g. created with std::bind). The function objects are kept in a fixed
+// number of slots inside the kernel and are called through a delegate.
+// This path is slower and may allocate memory - use delegates instead.
+// These tasks are never coalesced.
+#define TASK_LEGACY_SLOTS 32
+bool schedule_task(Module *mod, std::function<void ()> f);
+bool schedule_task(Module *mod, std::function<void ()> f, uint8_t priority);
+
+/*
+    The kernel provides timers for tasks that have to be executed periodically
+    or once after a given delay. This saves the modules from polling the time
+    in their interrupt routine. The timers are kept in a hashed timing wheel
+    with one slot per millisecond. Every timer sits in the slot of its next
+    expiration, so with every systick only the timers of one slot are checked.
+    When a timer expires its task is scheduled with the priority of the module.
+    
+    A periodic timer expires whenever (time % period) == (phase % period),
+    time being FC_time_now() in milliseconds. Giving different phases to
+    tasks of the same period keeps them from running in the same systick.
+    
+    Timers can be registered from the setup() of a module or from any task.
+    The registration returns a timer ID (or -1 if all timers are in use)
+    which can be used to cancel the timer. A module has to cancel its timers
+    in its destructor. The ID of a delayed task is released when the timer
+    expires and may be given to another timer afterwards. A timer is only
+    cancelled if it belongs to the given module, so a stale ID does no harm
+    to the timers of other modules.
+*/
+#define TIMER_WHEEL_SLOTS 64    // has to be a power of 2
+#define KERNEL_MAX_TIMERS 32
+
+int schedule_periodic_task(Module *mod, TaskFunct f, uint32_t period_ms, uint32_t phase_ms = 0);
+int schedule_delayed_task(Module *mod, TaskFunct f, uint32_t delay_ms);
+void cancel_timer(Module *mod, int timer_id);
 
 // This is the main loop of the kernel.
 // After setup the main program calls this function which then runs in foreground forever.
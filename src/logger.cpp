@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <utility>
 
 #include "global.h"
 #include "logger.h"
@@ -7,82 +8,68 @@
 Logger::Logger(std::string name) : Module(name)
 {
     runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
-    // open the connection
-    flag_message_pending = false;
-}
-
-void Logger::interrupt()
-{
-    // if there is something received in one of the input ports
-    // we have to handle it
-    if (in.count()>0) flag_message_pending = true;
-    if (flag_message_pending)
-    	schedule_task(this, std::bind(&Logger::run, this));
+    // every message received wakes up the worker function
+    in.set_handler(this, TaskDelegate::create<Logger, &Logger::run>(this));
 }
 
 void Logger::run()
 {
 
-    while (flag_message_pending)
+    while (in.count()>0)
     {
         Message msg = in.fetch();
-        // write out
-        text_out.transmit(msg.as_text());
-        flag_message_pending = (in.count()>0);
         // system messages are also sent via the system_out port
         if (msg.type()==MSG_TYPE_SYSTEM)
         {
             system_out.transmit(msg);
         };
+        // the sinks format the message themselves
+        text_out.transmit(std::move(msg));
     }
 }
 
 Requester::Requester(std::string name, float rate) : Module(name)
 {
     runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
-    // save the startup time and rate
-    last_update = FC_time_now();
+    // save the rate
     log_rate = rate;
+    run_timer = -1;
+    task_priority_ = TASK_PRIORITY_HOUSEKEEPING;
 }
 
-void Requester::interrupt()
+void Requester::setup()
 {
-    float elapsed = FC_elapsed_millis(last_update);
-    flag_update_pending = (elapsed*log_rate >= 1000.0);
-    if (flag_update_pending)
-    	schedule_task(this, std::bind(&Requester::run, this));
+    uint32_t period = 1000.0/log_rate;
+    run_timer = schedule_periodic_task(this, TaskDelegate::create<Requester, &Requester::run>(this), period);
+    if (run_timer < 0)
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
+    runlevel_ = MODULE_RUNLEVEL_SETUP_OK;
 }
 
 void Requester::run()
 {
-    if (flag_update_pending)
-    {
-        // query the data
-        Message msg = server_callback();
-        // get the system time
-        uint32_t time = FC_time_now();
-        // assemble the output message
-        // print the time in seconds
-        char buffer[16];
-        int n = snprintf(buffer, 15, "%10.3f", 0.001*time);
-        buffer[n] = '\0';
-        std::string text = std::string(buffer,n);
-        // separator
-        text += std::string(" : ");
-        // append the serialized message text
-        text += msg.print_content();
-        // write out
-        out.transmit(
-            Message::TextMessage(server_name, text)
-        );
-    };
-    last_update = FC_time_now();
-    flag_update_pending = false;
+    // no server registered yet or nobody to receive the output
+    if (!server_callback or !out.connected()) return;
+    // query the data
+    Message msg = server_callback();
+    // get the system time
+    uint32_t time = FC_time_now();
+    // assemble the output message
+    // print the time in seconds, the serialized message text follows
+    char text[MSG_MAX_TEXT+1];
+    int n = snprintf(text, 14, "%10.3f : ", 0.001*time);
+    if (n > 13) n = 13;
+    n += msg.print_content(text+n, sizeof(text)-n);
+    // write out
+    out.transmit(
+        Message::TextMessage(server_name, std::string(text,n))
+    );
 }
 
 void Requester::register_server_callback(std::function<Message(void)> f, std::string name)
 {
-    server_name = name;
+    server_name = FC_name_handle(name.c_str());
     server_callback = f;
 }
 
@@ -10,8 +10,11 @@
 #include "port.h"
 
 /* 
-    The logger receives a number of possible messages, serializes
-    them and sends them as text messages to a number of receivers.
+    The logger receives a number of possible messages and forwards
+    them to a number of text sinks (console, log file, USB).
+    The messages are passed on as they are, every sink formats them
+    into its own output buffer (see Message::printout()). So no text is
+    generated as long as no sink is wired, and it is generated only once per sink.
     
     One instance of this class will be created right at system
     start (system_log) that will hold all system messages until
@@ -29,10 +32,9 @@ public:
     // nothing to do
     virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
     
-    virtual void interrupt();
-    
     // This is the worker function being executed by the taskmanager.
-    // It writes all pending messages to the bus unless a limit of execution time is exceeded.
+    // It is scheduled whenever a message arrives at the input port
+    // and writes all pending messages to the bus.
     virtual void run();
 
     // destructor
@@ -41,16 +43,11 @@ public:
     // port at which arbitrary messages are received
     ReceiverPort in;
 
-    // port over which all messages are sent as text messages
+    // port over which all messages are forwarded to the text sinks
     SenderPort text_out;
 
     // filtered port for system messages only
     SenderPort system_out;
-    
-private:
-
-    // here are some flags indicating which work is due
-    bool  flag_message_pending;
 
 };
 
@@ -58,6 +55,7 @@ private:
 /* 
     The Requester queries a number of server messages at a predefined time interval,
     serializes them and sends them as text messages to a number of receivers.
+    Nothing is queried as long as no receiver is wired.
 */
 class Requester : public Module
 {
@@ -67,16 +65,14 @@ public:
     // constructor
     Requester(std::string name, float rate);
     
-    // nothing to do
-    virtual void setup() { runlevel_ = MODULE_RUNLEVEL_SETUP_OK; };
+    // the requests are registered with the kernel timers
+    virtual void setup();
     
-    virtual void interrupt();
-
     // This is the worker function being executed by the taskmanager when the interval has elapsed.
     virtual void run();
 
-    // destructor
-    virtual ~Requester() {};
+    // destructor, the timer is cancelled
+    virtual ~Requester() { cancel_timer(this, run_timer); };
     
     // Register a callback function of a server, where the logger can request a message.
     // std::function<return_type(list of argument_type(s))>
@@ -92,16 +88,13 @@ public:
 private:
     
     // here we store the server callback
-    std::string server_name;
+    // and the handle of the name under which its messages are sent
+    uint16_t server_name;
     std::function<Message(void)> server_callback;
 
-    // time of the last update
-    uint32_t last_update;
-    
     // repetition rate of the logging
     float log_rate;
-    
-    // when we have work to to
-    bool flag_update_pending;
+    // the kernel timer of run() (-1 if none)
+    int run_timer;
 
 };
@@ -1,44 +1,117 @@
 #include "message.h"
+#include "kernel.h"
+#include "pool.h"
+#include "telemetry.h"
+#include "util.h"
+#include <atomic>
+#include <cstdarg>
 #include <cstdio>
-#include <cstdlib> // for C-style memory handling
 #include <cstring> // for std::memcpy
+#include <new>
+#include <utility> // for std::move
 // include <iostream> // for std::cout during debugging
 #include <Arduino.h> // for USB during debugging
 
+/*
+    The data blob of a message is preceded by this header holding the number
+    of messages sharing the blob. It is 8 bytes long, so the data keep
+    the alignment of the memory block (doubles in the data structs).
+*/
+struct MessageHeader
+{
+    std::atomic<uint32_t> refs;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(MessageHeader) == 8, "the message header must keep the data aligned");
+
+static inline MessageHeader* header(void *data)
+{
+    return (MessageHeader*)data - 1;
+}
+
+static_assert(MESSAGE_INLINE_SIZE % 8 == 0, "MESSAGE_INLINE_SIZE must be a multiple of 8");
+
+void Message::allocate(uint16_t size)
+{
+    m_size = size;
+    // small data are kept inside the message
+    if (is_inline()) return;
+    if (size > 0)
+    {
+        MessageHeader *h = (MessageHeader *)FC_pool_alloc(sizeof(MessageHeader) + size);
+        new (&h->refs) std::atomic<uint32_t>(1);
+        m_data = h+1;
+    }
+    else
+        m_data = NULL;
+}
+
+void Message::release()
+{
+    if (!is_inline() and (m_data != NULL))
+    {
+        MessageHeader *h = header(m_data);
+        // the last reference frees the blob
+        if (h->refs.fetch_sub(1) == 1)
+            FC_pool_free(h);
+    };
+    m_size = 0;
+    m_data = NULL;
+}
+
+void Message::take(Message& other)
+{
+    m_sender = other.m_sender;
+    m_type = other.m_type;
+    m_size = other.m_size;
+    if (is_inline())
+        std::memcpy(m_inline, other.m_inline, MESSAGE_INLINE_SIZE);
+    else
+        m_data = other.m_data;
+    other.m_size = 0;
+    other.m_data = NULL;
+}
+
 Message::Message(
-    std::string sender_module,
+    uint16_t    sender,
     uint16_t    msg_type,
     uint16_t    msg_size,
     void*       msg_data)
 {
     // std::cout << "Message standard constructor";
-    m_sender_module = sender_module;
+    m_sender = sender;
     m_type = msg_type;
-    m_size = msg_size;
     // std::cout << " size=" << m_size << std::endl;
-    if (m_size>0)
-    {
-        m_data = malloc(m_size);
-        std::memcpy(m_data, msg_data, m_size);
-    }
-    else
-        m_data = NULL;
+    allocate(msg_size);
+    if ((msg_size>0) and (msg_data!=NULL))
+        std::memcpy(payload(), msg_data, m_size);
+}
+
+Message::Message(
+    const std::string& sender_module,
+    uint16_t    msg_type,
+    uint16_t    msg_size,
+    void*       msg_data) :
+    Message(FC_name_handle(sender_module.c_str()), msg_type, msg_size, msg_data)
+{
 }
 
 Message::Message(const Message& other)
 {
     // std::cout << "Message COPY constructor";
-    m_sender_module = other.m_sender_module;
+    m_sender = other.m_sender;
     m_type = other.m_type;
     m_size = other.m_size;
-    // std::cout << " size=" << m_size << std::endl;
-    if (m_size>0)
-    {
-        m_data = malloc(m_size);
-        std::memcpy(m_data, other.m_data, m_size);
-    }
+    if (is_inline())
+        // small data are just copied
+        std::memcpy(m_inline, other.m_inline, MESSAGE_INLINE_SIZE);
     else
-        m_data = NULL;
+    {
+        // share the data
+        m_data = other.m_data;
+        if (m_data != NULL) header(m_data)->refs.fetch_add(1);
+    };
 }
 
 Message& Message::operator=(const Message& other)
@@ -46,38 +119,356 @@ Message& Message::operator=(const Message& other)
     // protct against invalid self-assignment
     if (this != &other)
     {
-        m_sender_module = other.m_sender_module;
+        // take the new reference before the old one is released
+        // in case both messages share the same data
+        if (!other.is_inline() and (other.m_data != NULL))
+            header(other.m_data)->refs.fetch_add(1);
+        release();
+        m_sender = other.m_sender;
         m_type = other.m_type;
         m_size = other.m_size;
-        // free the old memory
-        if (m_size>0) free(m_data);
-        // copy the new data
-        if (other.m_size>0)
+        if (is_inline())
+            std::memcpy(m_inline, other.m_inline, MESSAGE_INLINE_SIZE);
+        else
+            m_data = other.m_data;
+    }
+    return *this;
+}
+
+Message::Message(Message&& other)
+{
+    // std::cout << "Message MOVE constructor";
+    take(other);
+}
+
+Message& Message::operator=(Message&& other)
+{
+    if (this != &other)
+    {
+        release();
+        take(other);
+    }
+    return *this;
+}
+
+bool Message::shared()
+{
+    return !is_inline() and (m_data != NULL) and (header(m_data)->refs.load() > 1);
+}
+
+void* Message::get_data()
+{
+    // copy-on-write
+    if (shared())
+    {
+        void *old = m_data;
+        allocate(m_size);
+        std::memcpy(m_data, old, m_size);
+        // the other messages may have been released in the meantime
+        if (header(old)->refs.fetch_sub(1) == 1)
+            FC_pool_free(header(old));
+    };
+    return payload();
+}
+
+/*
+    The binary codec used by buffer() and the constructor from buffer.
+    
+    For every message type there is a layout describing how the data blob
+    is put into the frame. The fields are listed in the sequence in which they
+    appear in the frame, all values are put little-endian without padding.
+    A field gives the offset in the data blob and either the size of the values
+    (1, 2, 4 or 8 bytes, floats and doubles are handled as 4- and 8-byte values),
+    CODEC_TEXT for a string or CODEC_RAW for the whole data blob as it is.
+    
+    The fixed part of the data blob (the struct) has the size given in the layout.
+    The characters of all strings follow after it (see message.h), in the frame
+    every string is put as its TextSize count followed by the characters.
+    A value field with a count of 0 repeats up to the end of the data blob.
+    
+    The data messages carry the hash of a telemetry variable which already
+    identifies the sender (see telemetry.h). Their frames do not contain the
+    sender ID (flag CODEC_NO_SENDER), the length byte just counts the data block.
+*/
+#define CODEC_END   0
+#define CODEC_TEXT  0x10
+#define CODEC_RAW   0x20
+
+// the flags of a layout
+#define CODEC_NO_SENDER 0x01
+
+// frame bytes in front of the data block (type, length, sender) and after it (CRC)
+#define CODEC_HEADER 3
+#define CODEC_SENDER_SIZE 8
+#define CODEC_TRAILER 2
+// the whole frame has to fit into 255 bytes
+#define CODEC_MAX_FRAME 255
+
+#define CODEC_MAX_FIELDS 4
+
+struct CodecField {
+    uint8_t     kind;
+    uint8_t     offset;
+    uint8_t     count;
+};
+
+struct CodecLayout {
+    uint16_t    type;
+    uint8_t     fixed_size;
+    CodecField  fields[CODEC_MAX_FIELDS];
+    uint8_t     flags;
+};
+
+static const CodecLayout codec_layouts[] =
+{
+    { MSG_TYPE_ABSTRACT, 0, { { CODEC_RAW, 0, 0 } } },
+    { MSG_TYPE_SYSTEM, sizeof(MSG_DATA_SYSTEM), {
+        { 1, offsetof(MSG_DATA_SYSTEM, severity_level), 1 },
+        { 4, offsetof(MSG_DATA_SYSTEM, time), 1 },
+        { CODEC_TEXT, offsetof(MSG_DATA_SYSTEM, text), 1 } } },
+    { MSG_TYPE_TEXT, sizeof(MSG_DATA_TEXT), {
+        { CODEC_TEXT, offsetof(MSG_DATA_TEXT, text), 1 } } },
+    { MSG_TYPE_TELEMETRY, sizeof(MSG_DATA_TELEMETRY), {
+        { 4, offsetof(MSG_DATA_TELEMETRY, time), 1 },
+        { CODEC_TEXT, offsetof(MSG_DATA_TELEMETRY, variable), 1 },
+        { CODEC_TEXT, offsetof(MSG_DATA_TELEMETRY, value), 1 } } },
+    { MSG_TYPE_GPS_POSITION, sizeof(MSG_DATA_GPS_POSITION), {
+        { 8, offsetof(MSG_DATA_GPS_POSITION, latitude), 1 },
+        { 8, offsetof(MSG_DATA_GPS_POSITION, longitude), 1 },
+        { 4, offsetof(MSG_DATA_GPS_POSITION, altitude), 1 } } },
+    { MSG_TYPE_SERVO, sizeof(MSG_DATA_SERVO), {
+        { 2, offsetof(MSG_DATA_SERVO, pos), NUM_SERVO_CHANNELS } } },
+    { MSG_TYPE_COMMAND, 0, { { CODEC_RAW, 0, 0 } } },
+    { MSG_TYPE_PING, 0, { { CODEC_RAW, 0, 0 } } },
+    { MSG_TYPE_PINGRESPONSE, 0, { { CODEC_RAW, 0, 0 } } },
+    { MSG_TYPE_TELEMETRY_VARIABLE, sizeof(MSG_TELEMETRY_VARIABLE), {
+        { 2, offsetof(MSG_TELEMETRY_VARIABLE, hash), 1 },
+        { CODEC_TEXT, offsetof(MSG_TELEMETRY_VARIABLE, variable), 1 } } },
+    // the data messages : hash and timestamp followed by the values
+    { MSG_TYPE_DATA_INT16, MSG_DATA_OFFSET_VALUES,
+        { { 2, 0, 1 }, { 4, 2, 1 }, { 2, 6, 0 } }, CODEC_NO_SENDER },
+    { MSG_TYPE_DATA_FLOAT, MSG_DATA_OFFSET_VALUES,
+        { { 2, 0, 1 }, { 4, 2, 1 }, { 4, 6, 0 } }, CODEC_NO_SENDER },
+    { MSG_TYPE_DATA_DOUBLE, MSG_DATA_OFFSET_VALUES,
+        { { 2, 0, 1 }, { 4, 2, 1 }, { 8, 6, 0 } }, CODEC_NO_SENDER },
+    { MSG_TYPE_DATA_GPS, MSG_DATA_OFFSET_VALUES+20,
+        { { 2, 0, 1 }, { 4, 2, 1 }, { 8, 6, 2 }, { 4, 22, 1 } }, CODEC_NO_SENDER },
+    { MSG_TYPE_IMU_AHRS, 12, { { 4, 0, 3 } } },
+    { MSG_TYPE_IMU_GYRO, 12, { { 4, 0, 3 } } },
+};
+
+static const CodecLayout* codec_layout(uint16_t type)
+{
+    for (const CodecLayout& layout : codec_layouts)
+        if (layout.type == type) return &layout;
+    return 0;
+}
+
+// the number of values of a value field in a data blob of the given size
+// (-1 if a repeated field does not fill the blob exactly)
+static int codec_count(const CodecField& f, int size)
+{
+    if (f.count != 0) return f.count;
+    if ((size < f.offset) or ((size - f.offset) % f.kind != 0)) return -1;
+    return (size - f.offset) / f.kind;
+}
+
+// Check a data blob against its layout.
+// Returns the size of the data block in the frame, -1 if the blob does not match.
+static int codec_measure(const CodecLayout* layout, const uint8_t* data, int size)
+{
+    if (size < layout->fixed_size) return -1;
+    int body = 0;
+    int expected = layout->fixed_size;
+    for (const CodecField& f : layout->fields)
+    {
+        if (f.kind == CODEC_END) break;
+        if (f.kind == CODEC_RAW)
         {
-            m_data = malloc(other.m_size);
-            std::memcpy(m_data, other.m_data, other.m_size);
+            body += size;
+            expected = size;
+        }
+        else if (f.kind == CODEC_TEXT)
+        {
+            body += 1 + data[f.offset];
+            expected += data[f.offset];
+        }
+        else
+        {
+            int n = codec_count(f, size);
+            if (n < 0) return -1;
+            body += n * f.kind;
+            if (f.count == 0) expected = size;
+        };
+    };
+    return (expected == size) ? body : -1;
+}
+
+// put a value little-endian
+static void codec_put(uint8_t* out, const uint8_t* value, int width)
+{
+    uint64_t v = 0;
+    switch (width)
+    {
+        case 1: v = *value; break;
+        case 2: { uint16_t x; std::memcpy(&x, value, 2); v = x; break; }
+        case 4: { uint32_t x; std::memcpy(&x, value, 4); v = x; break; }
+        case 8: std::memcpy(&v, value, 8); break;
+    };
+    for (int i=0; i<width; i++)
+        out[i] = (uint8_t)(v >> (8*i));
+}
+
+// get a little-endian value
+static void codec_get(uint8_t* value, const uint8_t* in, int width)
+{
+    uint64_t v = 0;
+    for (int i=0; i<width; i++)
+        v |= (uint64_t)in[i] << (8*i);
+    switch (width)
+    {
+        case 1: *value = (uint8_t)v; break;
+        case 2: { uint16_t x = v; std::memcpy(value, &x, 2); break; }
+        case 4: { uint32_t x = v; std::memcpy(value, &x, 4); break; }
+        case 8: std::memcpy(value, &v, 8); break;
+    };
+}
+
+Message::Message(const char* buffer, size_t size)
+{
+    m_sender = NAME_HANDLE_NONE;
+    m_type = MSG_TYPE_ABSTRACT;
+    m_size = 0;
+    m_data = NULL;
+    const uint8_t* frame = (const uint8_t*)buffer;
+    // check the frame
+    if (size < CODEC_HEADER + CODEC_TRAILER) return;
+    uint16_t type = (frame[0] << 8) | frame[1];
+    const CodecLayout* layout = codec_layout(type);
+    if (layout == 0) return;
+    int id_size = (layout->flags & CODEC_NO_SENDER) ? 0 : CODEC_SENDER_SIZE;
+    int length = frame[2];
+    if ((length < id_size) or (CODEC_HEADER + length + CODEC_TRAILER > (int)size)) return;
+    uint16_t crc = (frame[CODEC_HEADER+length] << 8) | frame[CODEC_HEADER+length+1];
+    if (crc != crc16(frame, CODEC_HEADER+length)) return;
+    // walk the data block to find the size of the data blob
+    const uint8_t* body = frame + CODEC_HEADER + id_size;
+    int body_size = length - id_size;
+    int pos = 0;
+    int blob_size = layout->fixed_size;
+    for (const CodecField& f : layout->fields)
+    {
+        if (f.kind == CODEC_END) break;
+        if (f.kind == CODEC_RAW)
+        {
+            blob_size = body_size;
+            pos = body_size;
+        }
+        else if (f.kind == CODEC_TEXT)
+        {
+            if (pos >= body_size) return;
+            blob_size += body[pos];
+            pos += 1 + body[pos];
         }
         else
-            m_data = NULL;
+        {
+            int n = f.count;
+            if (n == 0)
+            {
+                // the repeated values fill the rest of the data block
+                if ((body_size - pos) % f.kind != 0) return;
+                n = (body_size - pos) / f.kind;
+                blob_size = f.offset + n * f.kind;
+            };
+            pos += n * f.kind;
+        };
+        if (pos > body_size) return;
+    };
+    if (pos != body_size) return;
+    // now fill the data blob
+    allocate(blob_size);
+    uint8_t* data = (uint8_t*)payload();
+    if (blob_size > 0) std::memset(data, 0, blob_size);
+    uint8_t* text = data + layout->fixed_size;
+    pos = 0;
+    for (const CodecField& f : layout->fields)
+    {
+        if (f.kind == CODEC_END) break;
+        if (f.kind == CODEC_RAW)
+        {
+            if (blob_size > 0) std::memcpy(data, body, blob_size);
+        }
+        else if (f.kind == CODEC_TEXT)
+        {
+            uint8_t count = body[pos++];
+            data[f.offset] = count;
+            std::memcpy(text, body+pos, count);
+            text += count;
+            pos += count;
+        }
+        else
+        {
+            int n = codec_count(f, blob_size);
+            for (int i=0; i<n; i++)
+            {
+                codec_get(data + f.offset + i*f.kind, body+pos, f.kind);
+                pos += f.kind;
+            };
+        };
+    };
+    m_type = type;
+    if (id_size == 0)
+    {
+        // the sender is found from the hash of the telemetry variable
+        uint16_t hash;
+        std::memcpy(&hash, data + MSG_DATA_OFFSET_HASH, 2);
+        const TelemetryEntry* var = FC_telemetry_lookup(hash);
+        if (var != 0) m_sender = var->sender;
     }
-    return *this;
+    else
+    {
+        // the sender ID without the padding
+        char name[CODEC_SENDER_SIZE+1];
+        int n = CODEC_SENDER_SIZE;
+        std::memcpy(name, frame+CODEC_HEADER, CODEC_SENDER_SIZE);
+        while ((n > 0) and (name[n-1] == ' ')) n--;
+        name[n] = 0;
+        m_sender = FC_name_handle(name);
+    };
+    if (type == MSG_TYPE_TELEMETRY_VARIABLE)
+    {
+        // a declaration from a remote system is registered,
+        // so its data messages can be decoded
+        MSG_TELEMETRY_VARIABLE* d = (MSG_TELEMETRY_VARIABLE*)data;
+        std::string variable((char*)(d+1), d->variable);
+        FC_telemetry_register(d->hash, m_sender, variable.c_str());
+    };
+}
+
+Message::Message(char* buffer) :
+    Message(buffer, CODEC_HEADER + (uint8_t)buffer[2] + CODEC_TRAILER)
+{
 }
 
-Message::Message(char* buffer)
+Message Message::TextMessage(
+    const std::string& sender_module,
+    std::string text)
 {
+    return TextMessage(FC_name_handle(sender_module.c_str()), text);
 }
 
 Message Message::TextMessage(
-    std::string sender_module,
+    uint16_t    sender,
     std::string text)
 {
-    Message msg = Message(sender_module, MSG_TYPE_TEXT, 0, NULL);
+    Message msg = Message(sender, MSG_TYPE_TEXT, 0, NULL);
     // std::cout << "MSG_TYPE_TEXT constructor";
-    msg.m_size = sizeof(MSG_DATA_TEXT) + text.size();
-    msg.m_data = malloc(msg.m_size);
+    // the number of characters has to fit into TextSize
+    if (text.size() > MSG_MAX_TEXT) text.resize(MSG_MAX_TEXT);
+    msg.allocate(sizeof(MSG_DATA_TEXT) + text.size());
     // std::cout << " size=" << m_size << std::endl;
     // pointer to the allocated memory
-    MSG_DATA_TEXT *d = (MSG_DATA_TEXT *)msg.m_data;
+    MSG_DATA_TEXT *d = (MSG_DATA_TEXT *)msg.payload();
     d->text = text.size();
     // point to the rest of the memory block reserved for the string
     // the pointer is advanced by 1x the size of the object
@@ -90,22 +481,32 @@ Message Message::TextMessage(
 }
 
 Message Message::SystemMessage(
-    std::string sender_module,
+    const std::string& sender_module,
+    uint32_t    time,
+    uint8_t     severity_level,
+    std::string text)
+{
+    return SystemMessage(FC_name_handle(sender_module.c_str()), time, severity_level, text);
+}
+
+Message Message::SystemMessage(
+    uint16_t    sender,
     uint32_t    time,
     uint8_t     severity_level,
     std::string text)
 {
-    Message msg = Message(sender_module, MSG_TYPE_SYSTEM, 0, NULL);
+    Message msg = Message(sender, MSG_TYPE_SYSTEM, 0, NULL);
     // Serial.print("MSG_TYPE_SYSTEM constructor");
-    msg.m_size = sizeof(MSG_DATA_SYSTEM) + text.size();
-    msg.m_data = malloc(msg.m_size);
+    // the number of characters has to fit into TextSize
+    if (text.size() > MSG_MAX_TEXT) text.resize(MSG_MAX_TEXT);
+    msg.allocate(sizeof(MSG_DATA_SYSTEM) + text.size());
     // std::cout << " size=" << m_size << std::endl;
     // Serial.print("  text=");
     // Serial.print(text.size());
     // Serial.print("  m_size=");
     // Serial.println(msg.m_size);
     // pointer to the allocated memory
-    MSG_DATA_SYSTEM *d = (MSG_DATA_SYSTEM *)msg.m_data;
+    MSG_DATA_SYSTEM *d = (MSG_DATA_SYSTEM *)msg.payload();
     d->severity_level = severity_level;
     d->time = time;
     d->text = text.size();
@@ -120,18 +521,29 @@ Message Message::SystemMessage(
 };
 
 Message Message::TelemetryMessage(
-    std::string sender_module,
+    const std::string& sender_module,
+    uint32_t    time,
+    std::string variable,
+    std::string value)
+{
+    return TelemetryMessage(FC_name_handle(sender_module.c_str()), time, variable, value);
+}
+
+Message Message::TelemetryMessage(
+    uint16_t    sender,
     uint32_t    time,
     std::string variable,
     std::string value)
 {
-    Message msg = Message(sender_module, MSG_TYPE_TELEMETRY, 0, NULL);
+    Message msg = Message(sender, MSG_TYPE_TELEMETRY, 0, NULL);
     // std::cout << "MSG_TYPE_TELEMETRY constructor";
-    msg.m_size = sizeof(MSG_DATA_SYSTEM) + variable.size() + value.size();
-    msg.m_data = malloc(msg.m_size);
+    // the number of characters has to fit into TextSize
+    if (variable.size() > MSG_MAX_TEXT) variable.resize(MSG_MAX_TEXT);
+    if (value.size() > MSG_MAX_TEXT) value.resize(MSG_MAX_TEXT);
+    msg.allocate(sizeof(MSG_DATA_TELEMETRY) + variable.size() + value.size());
     // std::cout << " size=" << m_size << std::endl;
     // pointer to the allocated memory
-    MSG_DATA_TELEMETRY *d = (MSG_DATA_TELEMETRY *)msg.m_data;
+    MSG_DATA_TELEMETRY *d = (MSG_DATA_TELEMETRY *)msg.payload();
     d->time = time;
     d->variable = variable.size();
     d->value = value.size();
@@ -147,6 +559,59 @@ Message Message::TelemetryMessage(
     return msg;
 }
 
+Message Message::TelemetryVariable(
+    uint16_t    sender,
+    uint16_t    hash,
+    std::string variable)
+{
+    if (variable.size() > MSG_MAX_TEXT) variable.resize(MSG_MAX_TEXT);
+    Message msg = Message(sender, MSG_TYPE_TELEMETRY_VARIABLE, 0, NULL);
+    msg.allocate(sizeof(MSG_TELEMETRY_VARIABLE) + variable.size());
+    MSG_TELEMETRY_VARIABLE *d = (MSG_TELEMETRY_VARIABLE *)msg.payload();
+    d->hash = hash;
+    d->variable = variable.size();
+    // the name follows after the struct
+    std::memcpy(d+1, variable.data(), variable.size());
+    return msg;
+}
+
+// assemble the data blob of a data message : hash, timestamp and the packed values
+static Message data_message(uint16_t sender, uint16_t type, uint16_t hash, uint32_t time,
+    const void* values, size_t size)
+{
+    uint8_t blob[MSG_DATA_OFFSET_VALUES + 32];
+    std::memcpy(blob + MSG_DATA_OFFSET_HASH, &hash, 2);
+    std::memcpy(blob + MSG_DATA_OFFSET_TIME, &time, 4);
+    std::memcpy(blob + MSG_DATA_OFFSET_VALUES, values, size);
+    return Message(sender, type, MSG_DATA_OFFSET_VALUES + size, blob);
+}
+
+Message Message::DataMessage(uint16_t sender, uint16_t hash, uint32_t time, int16_t value)
+{
+    return data_message(sender, MSG_TYPE_DATA_INT16, hash, time, &value, sizeof(value));
+}
+
+Message Message::DataMessage(uint16_t sender, uint16_t hash, uint32_t time, float value)
+{
+    return data_message(sender, MSG_TYPE_DATA_FLOAT, hash, time, &value, sizeof(value));
+}
+
+Message Message::DataMessage(uint16_t sender, uint16_t hash, uint32_t time, double value)
+{
+    return data_message(sender, MSG_TYPE_DATA_DOUBLE, hash, time, &value, sizeof(value));
+}
+
+Message Message::DataMessage(uint16_t sender, uint16_t hash, uint32_t time,
+    const MSG_DATA_GPS_POSITION& position)
+{
+    // the values are packed without the padding of the struct
+    uint8_t values[20];
+    std::memcpy(values, &position.latitude, 8);
+    std::memcpy(values+8, &position.longitude, 8);
+    std::memcpy(values+16, &position.altitude, 4);
+    return data_message(sender, MSG_TYPE_DATA_GPS, hash, time, values, sizeof(values));
+}
+
 Message::~Message()
 {
     // std::cout << "Message destructor ";
@@ -165,204 +630,280 @@ Message::~Message()
                 std::cout << "MSG_TYPE_GPS_POSITION" << std::endl; break;
         };
     */
-    if (m_size>0) free(m_data);
+    release();
 }
 
-std::string Message::print_content()
+/*
+    The text of a message is formatted directly into a character buffer
+    given by the caller (usually the output buffer of a text sink).
+    The text is truncated if it does not fit, it is always terminated by a zero.
+*/
+struct TextBuffer
+{
+    char*   buffer;
+    size_t  size;
+    size_t  n;
+
+    TextBuffer(char* b, size_t s) : buffer(b), size(s), n(0) { if (size > 0) buffer[0] = 0; };
+
+    void put(const char* text, size_t count)
+    {
+        if (n+1 >= size) return;
+        if (count > size-1-n) count = size-1-n;
+        std::memcpy(buffer+n, text, count);
+        n += count;
+        buffer[n] = 0;
+    };
+
+    void put(const char* text) { put(text, strlen(text)); };
+
+    // fill with spaces up to the given column
+    void pad(size_t column)
+    {
+        while ((n < column) and (n+1 < size)) buffer[n++] = ' ';
+        if (size > 0) buffer[n] = 0;
+    };
+
+    void format(const char* fmt, ...) __attribute__ ((format (printf, 2, 3)))
+    {
+        if (n+1 >= size) return;
+        va_list args;
+        va_start(args, fmt);
+        int count = vsnprintf(buffer+n, size-n, fmt, args);
+        va_end(args);
+        if (count > 0) n += ((size_t)count < size-1-n) ? (size_t)count : size-1-n;
+    };
+};
+
+size_t Message::print_content(char* buffer, size_t size)
 {
-    // std::cout << "Message::print_content() size=" << m_size << std::endl;
-    // TODO: handle all other message types
-    std::string ret("");
+    TextBuffer t(buffer, size);
     switch (m_type)
         {
-            case MSG_TYPE_ABSTRACT:
-                {
-                    break;
-                };
             case MSG_TYPE_SYSTEM:
                 {
-                    // std::cout << "MSG_TYPE_SYSTEM  header=" << sizeof(MSG_DATA_SYSTEM);
-                    MSG_DATA_SYSTEM *ptr = (MSG_DATA_SYSTEM *)m_data;
-                    char buffer[12];
-                    // time
-                    int n = snprintf(buffer, 11, "%10.3f", (double)(ptr->time)*0.001);
-                    ret += std::string(buffer,n);
-                    // separator
-                    ret += std::string(" : ");
-                    // severity level
-                    n = snprintf(buffer, 5, "%4d", ptr->severity_level);
-                    ret += std::string(buffer,n);
-                    // separator
-                    ret += std::string(" : ");
-                    // this is the number of characters in the text
-                    int count = ptr->text;
-                    // std::cout << " characters=" << count << std::endl;
-                    // advance the pointer beyond the data structure (where the text is)
-                    ptr++;
-                    char *t = (char *)ptr;
-                    // message text
-                    for (int i=0; i<count; i++)
-                        ret += *t++;
+                    MSG_DATA_SYSTEM *ptr = (MSG_DATA_SYSTEM *)payload();
+                    t.format("%10.3f : %4d : ", (double)(ptr->time)*0.001, ptr->severity_level);
+                    // the text follows after the data structure
+                    t.put((char *)(ptr+1), ptr->text);
                     break;
                 };
             case MSG_TYPE_TEXT:
                 {
-                    // std::cout << "MSG_TYPE_TEXT  header=" << sizeof(MSG_TYPE_TEXT);
                     // this message contains just one string
-                    char* ptr = (char *)m_data;
-                    // the pointer initially points to the length byte
-                    int count = *ptr++;
-                    // std::cout << " characters=" << count << std::endl;
-                    // now append all characters
-                    for (int i=0; i<count; i++)
-                        ret += *ptr++;
+                    // preceded by its number of characters
+                    char* ptr = (char *)payload();
+                    t.put(ptr+1, (uint8_t)ptr[0]);
                     break;
                 };
             case MSG_TYPE_TELEMETRY:
                 {
-                    // std::cout << "MSG_TYPE_TELEMETRY  header=" << sizeof(MSG_DATA_TELEMETRY);
-                    MSG_DATA_TELEMETRY *ptr = (MSG_DATA_TELEMETRY *)m_data;
-                    char buffer[12];
-                    // time
-                    int n = snprintf(buffer, 11, "%10.3f", (double)(ptr->time)*0.001);
-                    ret += std::string(buffer,n);
-                    // separator
-                    ret += std::string(" : ");
-                    // size of the text fields
-                    int var_count = ptr->variable;
-                    int val_count = ptr->value;
-                    // advance the pointer beyond the data structure (where the text is)
-                    ptr++;
-                    char *t = (char *)ptr;
-                    // variable name
-                    for (int i=0; i<var_count; i++)
-                        ret += *t++;
-                    for (int i=var_count; i<8; i++)
-                        ret += " ";
-                    // separator
-                    ret += std::string(" : ");
-                    // value
-                    for (int i=0; i<val_count; i++)
-                        ret += *t++;
+                    MSG_DATA_TELEMETRY *ptr = (MSG_DATA_TELEMETRY *)payload();
+                    t.format("%10.3f : ", (double)(ptr->time)*0.001);
+                    // the texts follow after the data structure
+                    const char *text = (const char *)(ptr+1);
+                    size_t start = t.n;
+                    t.put(text, ptr->variable);
+                    t.pad(start+8);
+                    t.put(" : ");
+                    t.put(text + ptr->variable, ptr->value);
                     break;
                 };
             case MSG_TYPE_GPS_POSITION:
                 {
-                    // std::cout << "MSG_TYPE_GPS_POSITION  header=" << sizeof(MSG_DATA_GPS_POSITION);
-                    MSG_DATA_GPS_POSITION *ptr = (MSG_DATA_GPS_POSITION *)m_data;
-                    char buffer[16];
-                    // latitude
-                    int n = snprintf(buffer, 15, "%10.6f", ptr->latitude);
-                    ret += "lat=";
-                    ret += std::string(buffer,n);
-                    // longitude
-                    n = snprintf(buffer, 15, "%11.6f", ptr->longitude);
-                    ret += ", long=";
-                    ret += std::string(buffer,n);
-                    // altitude
-                    n = snprintf(buffer, 15, "%7.2f", ptr->altitude);
-                    ret += ", alti=";
-                    ret += std::string(buffer,n);
+                    MSG_DATA_GPS_POSITION *ptr = (MSG_DATA_GPS_POSITION *)payload();
+                    t.format("lat=%10.6f, long=%11.6f, alti=%7.2f",
+                        ptr->latitude, ptr->longitude, ptr->altitude);
+                    break;
+                };
+            case MSG_TYPE_TELEMETRY_VARIABLE:
+                {
+                    MSG_TELEMETRY_VARIABLE *ptr = (MSG_TELEMETRY_VARIABLE *)payload();
+                    t.format("hash=0x%04X : ", ptr->hash);
+                    // the name follows after the struct
+                    t.put((char *)(ptr+1), ptr->variable);
+                    break;
+                };
+            case MSG_TYPE_DATA_INT16:
+            case MSG_TYPE_DATA_FLOAT:
+            case MSG_TYPE_DATA_DOUBLE:
+            case MSG_TYPE_DATA_GPS:
+                {
+                    // only here the record is turned into text
+                    const uint8_t *ptr = (const uint8_t *)payload();
+                    uint16_t hash;
+                    uint32_t time;
+                    std::memcpy(&hash, ptr + MSG_DATA_OFFSET_HASH, 2);
+                    std::memcpy(&time, ptr + MSG_DATA_OFFSET_TIME, 4);
+                    t.format("%10.3f : ", (double)(time)*0.001);
+                    // variable name (the hash if the variable is unknown)
+                    size_t start = t.n;
+                    const TelemetryEntry* var = FC_telemetry_lookup(hash);
+                    if (var != 0)
+                        t.put(var->name);
+                    else
+                        t.format("#%04X", hash);
+                    t.pad(start+8);
+                    t.put(" : ");
+                    // the values
+                    const uint8_t *v = ptr + MSG_DATA_OFFSET_VALUES;
+                    const uint8_t *end = ptr + m_size;
+                    if (m_type == MSG_TYPE_DATA_GPS)
+                    {
+                        MSG_DATA_GPS_POSITION pos;
+                        std::memcpy(&pos.latitude, v, 8);
+                        std::memcpy(&pos.longitude, v+8, 8);
+                        std::memcpy(&pos.altitude, v+16, 4);
+                        t.format("lat=%10.6f, long=%11.6f, alti=%7.2f",
+                            pos.latitude, pos.longitude, pos.altitude);
+                        break;
+                    };
+                    while (v < end)
+                    {
+                        if (v > ptr + MSG_DATA_OFFSET_VALUES) t.put(" ");
+                        if (m_type == MSG_TYPE_DATA_INT16)
+                        {
+                            int16_t x;
+                            std::memcpy(&x, v, 2);
+                            t.format("%d", x);
+                            v += 2;
+                        }
+                        else if (m_type == MSG_TYPE_DATA_FLOAT)
+                        {
+                            float x;
+                            std::memcpy(&x, v, 4);
+                            t.format("%g", x);
+                            v += 4;
+                        }
+                        else
+                        {
+                            double x;
+                            std::memcpy(&x, v, 8);
+                            t.format("%.10g", x);
+                            v += 8;
+                        };
+                    };
                     break;
                 };
             default:
                 {
+                    // TODO: handle all other message types
                     break;
                 };
         };
-    return ret;
+    return t.n;
 }
 
-std::string Message::printout()
+std::string Message::print_content()
 {
-    std::string text = m_sender_module;
-    // pad with spaces to 8 characters
-    size_t len = text.size();
-    if (len<8)
-    {
-        std::string space(8-len, ' ');
-        text += space;
-    };
-    text = text.substr(0, 8);
+    char text[MSG_MAX_PRINTOUT+1];
+    size_t n = print_content(text, sizeof(text));
+    return std::string(text, n);
+}
+
+const char* Message::sender_name()
+{
+    return FC_name(m_sender);
+}
+
+size_t Message::printout(char* buffer, size_t size)
+{
+    if (size == 0) return 0;
+    TextBuffer t(buffer, size);
+    // the sender name padded with spaces to 8 characters
+    const char* name = FC_name(m_sender);
+    t.put(name, strnlen(name, 8));
+    t.pad(8);
     // separator
-    text += std::string(" : ");
+    t.put(" : ");
     // message text
-    text += print_content();
-    return text;
+    return t.n + print_content(buffer + t.n, size - t.n);
+}
+
+std::string Message::printout()
+{
+    char text[MSG_MAX_PRINTOUT+1];
+    size_t n = printout(text, sizeof(text));
+    return std::string(text, n);
 }
 
 Message Message::as_text()
 {
-    return Message::TextMessage(m_sender_module, print_content());
+    return Message::TextMessage(m_sender, print_content());
 }
 
 uint8_t Message::buffer(char* buffer, size_t size)
 {
-    // check for buffer size
-    if (size<12) return 0;
-    char* ptr = buffer;
+    const CodecLayout* layout = codec_layout(m_type);
+    if (layout == 0) return 0;
+    const uint8_t* data = (const uint8_t*)payload();
+    int body_size = codec_measure(layout, data, m_size);
+    if (body_size < 0) return 0;
+    int id_size = (layout->flags & CODEC_NO_SENDER) ? 0 : CODEC_SENDER_SIZE;
+    // if the frame does not fit, a text at the end of the data block is truncated
+    if (size > CODEC_MAX_FRAME) size = CODEC_MAX_FRAME;
+    int space = (int)size - CODEC_HEADER - id_size - CODEC_TRAILER;
+    int cut = body_size - space;
+    if (cut < 0) cut = 0;
+    int last = 0;
+    while ((last+1 < CODEC_MAX_FIELDS) and (layout->fields[last+1].kind != CODEC_END)) last++;
+    if (cut > 0)
+    {
+        if ((layout->fields[last].kind != CODEC_TEXT) or (cut > data[layout->fields[last].offset]))
+            return 0;
+        body_size -= cut;
+    };
+    uint8_t* frame = (uint8_t*)buffer;
     // mesagge type is encoded with two bytes, high byte first
-    char *source = (char*) &m_type;
-    buffer[1] = *source++;
-    buffer[0] = *source++;
-    // reserve one byte for the message size (we don't know it yet)
-    ptr+=3;
+    frame[0] = m_type >> 8;
+    frame[1] = m_type & 0xFF;
+    frame[2] = id_size + body_size;
     // sender ID is put as a fixed length of 8 characters
-    size_t n=0;
-    while ((n<m_sender_module.size()) and (n<8))
+    const char* name = FC_name(m_sender);
+    int n=0;
+    while ((n<id_size) and (name[n]!=0))
     {
-        *ptr++ = m_sender_module[n];
+        frame[CODEC_HEADER+n] = name[n];
         n++;
     };
-    while (n<8)
+    while (n<id_size)
     {
-        *ptr++ = 0x20; // fill with spaces
+        frame[CODEC_HEADER+n] = 0x20; // fill with spaces
         n++;
     };
-    uint8_t n_bytes = 11; // 2+1+8 bytes fixed information
-    // the data block is put as compact as possible (depending on the type)
-    // number of free bytes remaining in the buffer
-    uint8_t remaining = size-11;
-    switch (m_type)
+    // the data block
+    uint8_t* out = frame + CODEC_HEADER + id_size;
+    const uint8_t* text = data + layout->fixed_size;
+    for (int i=0; i<=last; i++)
     {
-        case MSG_TYPE_SYSTEM:
+        const CodecField& f = layout->fields[i];
+        if (f.kind == CODEC_RAW)
         {
-            MSG_DATA_SYSTEM *md = (MSG_DATA_SYSTEM *)m_data;
-            int count = md->text;
-            // Serial.print("\nMSG_DATA_SYSTEM size=");
-            // Serial.println(count);
-            // check for buffer size (keep one byte for checksum)
-            if (remaining > 5)
-            {
-	            // if we can at least send a single character we go with a truncated message
-            	if (count>remaining-5) count=remaining-5;
-                *ptr = md->severity_level;
-                std::memcpy(ptr+1, &(md->time), 4);
-                n_bytes += 5;
-                // the number of characters is not needed in the block, because the total length is known
-                // the text content starts at the next character after the m_data struct
-                uint8_t *txt = (uint8_t *) m_data;
-                txt += sizeof(MSG_DATA_SYSTEM);
-                // now append all characters
-                std::memcpy(ptr+5, txt, count);
-                n_bytes += count;
-            };
-            // if buffer size is insufficient go ahead with missing data block
-            break;
-        };
-        case MSG_TYPE_TEXT:
+            if (m_size > 0) std::memcpy(out, data, m_size);
+            out += m_size;
+        }
+        else if (f.kind == CODEC_TEXT)
         {
-            // TODO
-            break;
-        };
-        // TODO: more cases
-        default:
+            uint8_t count = data[f.offset];
+            uint8_t put = (i == last) ? count - cut : count;
+            *out++ = put;
+            std::memcpy(out, text, put);
+            out += put;
+            text += count;
+        }
+        else
         {
+            int values = codec_count(f, m_size);
+            for (int k=0; k<values; k++)
+            {
+                codec_put(out, data + f.offset + k*f.kind, f.kind);
+                out += f.kind;
+            };
         };
-    }    
-    // the message size is put into the buffer (the type word and size byte are not counted)
-    buffer[2] = n_bytes-3;
-    // TODO add a CRC checksum
-    return n_bytes;
+    };
+    // the CRC covers the whole frame
+    uint16_t crc = crc16(frame, out - frame);
+    *out++ = crc >> 8;
+    *out++ = crc & 0xFF;
+    return out - frame;
 }
-
@@ -41,6 +41,17 @@
 #define MSG_TYPE_COMMAND        0xcc86
 #define MSG_TYPE_PING           0xcc87
 #define MSG_TYPE_PINGRESPONSE   0xcc88
+#define MSG_TYPE_TELEMETRY_VARIABLE 0xcc89
+
+/*
+    Data blobs up to this size are stored inside the message itself
+    instead of being taken from the message pool. This covers most system
+    messages, GPS positions and servo commands. The size was chosen
+    with the host benchmark sim/test/message_bench.cpp, it must be a multiple of 8.
+*/
+#ifndef MESSAGE_INLINE_SIZE
+#define MESSAGE_INLINE_SIZE 32
+#endif
 
 /*
     All messages have a data body which has to be interpreted depending on the message type.
@@ -55,6 +66,10 @@
     Alternatively define them as struct __attribute__ ((packed))
 */
 using TextSize = uint8_t;
+// longer strings are truncated
+#define MSG_MAX_TEXT 255
+// the longest text printout() can produce (sender, time and two texts of a telemetry message)
+#define MSG_MAX_PRINTOUT 544
 
 struct MSG_DATA_SYSTEM {
     uint8_t     severity_level;
@@ -94,9 +109,9 @@ struct MSG_DATA_SERVO {
 };
 
 /*
-    This message declares a telemetry vaiable.
+    This message declares a telemetry vaiable (MSG_TYPE_TELEMETRY_VARIABLE).
     The combination of sender and variable name can be replaced
-    by the hash in future data value transmissions.
+    by the hash in future data value transmissions (see telemetry.h).
     The hash also defines the data size and variable types
 */
 struct MSG_TELEMETRY_VARIABLE {
@@ -108,6 +123,12 @@ struct MSG_TELEMETRY_VARIABLE {
     for all data messages no sender information (that is encoded in the hash)
     and no size is transmitted (that is encoded in the MSG_TYPE)
     just the timestamp and binary data
+    
+    Inside the system the data blob of these messages holds the uint16_t hash,
+    the uint32_t timestamp [ms] and the values without any padding.
+    The INT16, FLOAT and DOUBLE messages can carry any number of values.
+    The IMU messages carry just the DATA_IMU_AHRS or DATA_IMU_GYRO struct
+    (see types.h) without hash and timestamp.
 */
 #define MSG_TYPE_DATA_INT16     0xcc90
 #define MSG_TYPE_DATA_FLOAT     0xcc98
@@ -116,10 +137,27 @@ struct MSG_TELEMETRY_VARIABLE {
 #define MSG_TYPE_IMU_AHRS       0xcca1      // float attitude, heading, roll
 #define MSG_TYPE_IMU_GYRO       0xcca2      // float nick, yaw, roll
 
+// the offsets within the data blob of a data message
+#define MSG_DATA_OFFSET_HASH    0
+#define MSG_DATA_OFFSET_TIME    2
+#define MSG_DATA_OFFSET_VALUES  6
+
 /*
     This is a message the can be sent and received in between modules.
     It holds information about the sender module and the size of the transmitted data block.
+    The sender is identified by the handle of its interned name (see FC_name_handle()),
+    the name itself is only looked up when the message is formatted or serialized.
     The type information encodes which struct to use in order to decode the data blob.
+    
+    The data blob is shared between all copies of a message. It carries a reference
+    count and is only freed when the last copy is destroyed. So, sending a message
+    to any number of receivers just hands out references to the same data.
+    The data should be considered immutable. Reading them through data() never copies
+    anything. If a receiver needs to modify the data it has to use get_data()
+    which first makes a private copy if the data are shared (copy-on-write).
+    
+    Small data blobs (up to MESSAGE_INLINE_SIZE bytes) are not allocated at all,
+    they are kept inside the message and copied along with it.
 */
 class Message {
     public:
@@ -128,17 +166,36 @@ class Message {
         Message() = delete;
         
         // copy constructor
+        // the data blob is shared, not copied
         Message(const Message& other);
         
         // copy assignment operator
+        // the data blob is shared, not copied
         Message& operator=(const Message& other);
 
+        // move constructor
+        // the data blob is taken over, the other message is left without data
+        Message(Message&& other);
+
+        // move assignment operator
+        // the data blob is taken over, the other message is left without data
+        Message& operator=(Message&& other);
+
         // Standard constructor:
-        // This allocates a buffer of the requested size and copies the data
+        // This allocates a buffer of the requested size from the message pool
+        // (see pool.h) and copies the data
         // referenced by the given pointer into this buffer.
         // If a size 0 is given, the pointer remains NULL.
         Message(
-            std::string sender_module,
+            uint16_t    sender,
+            uint16_t    msg_type,
+            uint16_t    msg_size,
+            void*       msg_data);
+
+        // The same with the sender given by name.
+        // This has to look up the name, modules should rather use their handle().
+        Message(
+            const std::string& sender_module,
             uint16_t    msg_type,
             uint16_t    msg_size,
             void*       msg_data);
@@ -147,17 +204,31 @@ class Message {
         // This is used to re-create a message from the compact binary format
         // which is used for transmission over low-bandwidth channels (e.g. modem)
         // All information is contained in the buffer (sender id, message type, length).
-        // TODO: no implementation yet
+        // Received declarations of telemetry variables are registered.
+        // The frame is checked strictly (length, CRC and the layout of the data block).
+        // A buffer not holding a valid message gives an empty message
+        // of MSG_TYPE_ABSTRACT without sender (NAME_HANDLE_NONE).
+        Message(const char* buffer, size_t size);
+        
+        // the same for a buffer that is known to hold a complete frame
         Message(char* buffer);
         
         // named Constructor for a MSG_TYPE_TEXT message
         static Message TextMessage(
-            std::string sender_module,
+            uint16_t    sender,
+            std::string text);
+        static Message TextMessage(
+            const std::string& sender_module,
             std::string text);
             
         // Constructor for a MSG_TYPE_SYSTEM message
         static Message SystemMessage(
-            std::string sender_module,
+            uint16_t    sender,
+            uint32_t    time,
+            uint8_t     severity_level,
+            std::string text);
+        static Message SystemMessage(
+            const std::string& sender_module,
             uint32_t    time,
             uint8_t     severity_level,
             std::string text);
@@ -166,22 +237,58 @@ class Message {
         // this also creates the hash for the defined message
         // the sender must store this hash to subsequently send data messages
         static Message TelemetryMessage(
-            std::string sender_module,
+            uint16_t    sender,
             uint32_t    time,
             std::string variable,
             std::string value);
+        static Message TelemetryMessage(
+            const std::string& sender_module,
+            uint32_t    time,
+            std::string variable,
+            std::string value);
+
+        // Constructor for a MSG_TYPE_TELEMETRY_VARIABLE message
+        // This announces a telemetry variable of the sender together with the hash
+        // identifying it in subsequent data messages. The variable has to be
+        // registered before (see FC_telemetry_declare()).
+        static Message TelemetryVariable(
+            uint16_t    sender,
+            uint16_t    hash,
+            std::string variable);
+
+        // Constructors for the data messages (MSG_TYPE_DATA_xxx)
+        // carrying one sample of a declared telemetry variable
+        static Message DataMessage(uint16_t sender, uint16_t hash, uint32_t time, int16_t value);
+        static Message DataMessage(uint16_t sender, uint16_t hash, uint32_t time, float value);
+        static Message DataMessage(uint16_t sender, uint16_t hash, uint32_t time, double value);
+        static Message DataMessage(uint16_t sender, uint16_t hash, uint32_t time,
+            const MSG_DATA_GPS_POSITION& position);
                  
-        // we need a destructor to free any allocated memory
+        // we need a destructor to release the data blob
         ~Message();
         
+        // the handle of the sender name
+        uint16_t sender() { return m_sender; };
+        
+        // the name of the sender
+        const char* sender_name();
+        
         // type reporting function
         uint16_t type() { return m_type; };
         
         // type reporting function
         uint16_t size() { return m_size; };
         
-        // data extraction fuction - get a pointer to the data struct
-        void* get_data() { return m_data; }; 
+        // data extraction fuction - get a read-only pointer to the data struct
+        const void* data() { return payload(); };
+        
+        // data extraction fuction - get a pointer to the data struct for modification
+        // if the data are shared with other messages a private copy is made first
+        void* get_data();
+        
+        // if the data blob is shared with other copies of the message
+        // (data stored inside the message are never shared)
+        bool shared();
         
         // Generate a string with a standardized format holding the content of the message.
         std::string print_content();
@@ -191,6 +298,14 @@ class Message {
         // the message content as formatted by print_content()
         // There is no CR/LF at the end of the string, a print routine has to add that if necessary.
         std::string printout();
+
+        // The same, but the text is formatted directly into the given buffer
+        // (e.g. the output buffer of a text sink) without any allocation.
+        // The text is truncated if it does not fit, it is always terminated by a zero.
+        // They return the number of characters written (without the terminating zero).
+        // A buffer of MSG_MAX_PRINTOUT+1 characters holds any message.
+        size_t print_content(char* buffer, size_t size);
+        size_t printout(char* buffer, size_t size);
         
         // Generate a text message with all information but the sender id serialized
         // using the printout() generated format
@@ -199,14 +314,48 @@ class Message {
         // put a compact date block describing the message, suitable for transmission
         // over low-bandwidth communication channels into a given data buffer
         // it returns the number of bytes actually used
+        //
+        // The frame consists of
+        //   2 bytes    message type (high byte first)
+        //   1 byte     length n of the following sender ID and data block
+        //   8 bytes    sender ID (padded with spaces)
+        //   n-8 bytes  data block
+        //   2 bytes    CRC-16 (CCITT) of all preceding bytes (high byte first)
+        // The frames of the data messages (MSG_TYPE_DATA_xxx) do not contain the sender ID,
+        // it is restored from the hash of the telemetry variable (see telemetry.h).
+        // All values in the data block are put little-endian without padding,
+        // every text is preceded by its number of characters (see message.cpp for the layouts).
+        // If the buffer is too small for a message ending with a text, the text
+        // is truncated. Otherwise (and for messages not matching their layout)
+        // nothing is written and 0 is returned.
         uint8_t buffer(char* buffer, size_t size);
         
     protected:
+        // get a new data blob of the given size (m_size is set)
+        void allocate(uint16_t size);
+        
+        // drop the reference to the data blob, it is freed if this was the last one
+        void release();
+        
+        // if the data are stored inside the message
+        bool is_inline() const { return (m_size > 0) and (m_size <= MESSAGE_INLINE_SIZE); };
+        
+        // the data wherever they are stored
+        void* payload() { return is_inline() ? (void*)m_inline : m_data; };
+        
+        // take over the data of another message which is left without data
+        void take(Message& other);
+    
         // there is one single member that is required for all messages
-        // the sender module of the message
-        std::string m_sender_module;
+        // the sender module of the message (handle of the interned name)
+        uint16_t    m_sender;
         uint16_t    m_type;
         uint16_t    m_size;
-        void*       m_data;
+        union {
+            // the data blob (preceded by the reference count)
+            void*       m_data;
+            // or the data themselves if they are small enough
+            uint64_t    m_inline[MESSAGE_INLINE_SIZE/8];
+        };
 };
 
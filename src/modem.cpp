@@ -2,6 +2,7 @@
 
 #include "HardwareSerial.h"
 #include "util.h"
+#include <utility>
 
 // this is the RTS pin for the modem, used for M0 and M1 wired in parallel
 // high means config mode, low is transceiver mode
@@ -18,6 +19,8 @@ Modem::Modem(
     // nothing received yet
     uplink_num_chars = 0;
     message_num_chars_pending = 0;
+    // the serial line and the AUX pin are polled with every systick
+    uses_interrupt_ = true;
 }
 
 /*
@@ -45,7 +48,7 @@ void Modem::setup()
         if (FC_elapsed_millis(last_time)>1000)
         {
             status_out.transmit(
-                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "failed to initialize.") );
+                Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "failed to initialize.") );
             runlevel_ = MODULE_RUNLEVEL_ERROR;
             return;
         }
@@ -56,7 +59,7 @@ void Modem::setup()
     Serial1.setTimeout(0);
     // send a message to the system_log
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
     // init hardware
     // pull M0/M1 high (sleep/config mode)
     pinMode(MODEM_M0_M1, OUTPUT);
@@ -84,7 +87,7 @@ void Modem::setup()
         if (FC_elapsed_millis(last_time)>1000)
         {
             status_out.transmit(
-                Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "no configuration response.") );
+                Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "no configuration response.") );
             runlevel_ = MODULE_RUNLEVEL_ERROR;
             return;
         }
@@ -109,17 +112,17 @@ void Modem::setup()
         report += hexbyte(uplink_buffer[i]);
     };
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report) );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATUSREPORT, report) );
     // check for correct configuration
     if ((uplink_num_chars==9) and (uplink_buffer[0]==0xC1))
     {
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "configured OK.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "configured OK.") );
     }
     else
     {
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "illegal configuration response.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "illegal configuration response.") );
         runlevel_ = MODULE_RUNLEVEL_ERROR;
         return;
     }
@@ -138,7 +141,7 @@ void Modem::setup()
     last_time = FC_time_now();
     while (FC_elapsed_millis(last_time) < 100) {};
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_MILESTONE, "up and running.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_MILESTONE, "up and running.") );
     runlevel_ =  MODULE_RUNLEVEL_OPERATIONAL;
 }
 
@@ -158,20 +161,20 @@ void Modem::interrupt()
     };
     // see if we have received something
     if (Serial1.available() > 0)
-    	schedule_task(this, std::bind(&Modem::receive, this));
+    	schedule_task(this, TaskDelegate::create<Modem, &Modem::receive>(this));
     // when we have received something, but the receeiver is idle for 5ms
     // then we have the complete message
     // this implies the modem is not busy()
     if ((uplink_num_chars>0) and elapsed>5)
-    	schedule_task(this, std::bind(&Modem::process_message, this));
+    	schedule_task(this, TaskDelegate::create<Modem, &Modem::process_message>(this));
     // if there is something received in one of the input ports
     // we have to handle it unless the modem is busy()
     // we wait 10 ms after busy() giving receiving messages higher priority than sending
     if ((runlevel_>=16) and (downlink.count()>0) and (elapsed>10))
-    	schedule_task(this, std::bind(&Modem::send_message, this));
+    	schedule_task(this, TaskDelegate::create<Modem, &Modem::send_message>(this));
 	// if the message is not yet completely sent, we try to continue
     if (message_num_chars_pending>0)
-    	schedule_task(this, std::bind(&Modem::send_message, this));
+    	schedule_task(this, TaskDelegate::create<Modem, &Modem::send_message>(this));
 }
 
 void Modem::receive()
@@ -197,7 +200,7 @@ void Modem::process_message()
 	    report += hexbyte(uplink_buffer[i]);
 	};
 	status_out.transmit(
-	    Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report) );
+	    Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATUSREPORT, report) );
 	// check for and answer a ping
 	// TODO: this check could be a method of the Message class
 	if (uplink_num_chars>=7)
@@ -230,7 +233,7 @@ void Modem::process_message()
 	                    msg_len,
 	                    uplink_buffer+3
 	                    );
-                    uplink.transmit(command);
+                    uplink.transmit(std::move(command));
                 };
             };	
 	// empty the buffer
@@ -20,8 +20,13 @@
 
 #include <cstddef>
 #include <string>
+#include "kernel.h"
 #include "port.h"
 
+// the number of different tasks (entry points) of one module
+// that can be tracked while waiting in the task queue
+#define MODULE_MAX_PENDING_TASKS 8
+
 // after the constructor of a module has been executed,
 // the module status can either be ERROR or STOP
 #define MODULE_RUNLEVEL_ERROR -1
@@ -44,9 +49,10 @@
     All components of the flight stack are represented as modules
     that communicate among each other sending and receiving messages.
     
-    Modules sit in the background and are periodically queried by the scheduler
-    whether they have some work to do. They will answer based on the
-    system clock, on received messages or hardware generated events.
+    Modules sit in the background and get their work scheduled as tasks.
+    This is triggered by messages arriving at their ports, by kernel timers
+    or (for modules that poll hardware) from their interrupt() routine
+    which is called with every systick.
 */
 class Module
 {
@@ -57,7 +63,14 @@ public:
 	// All derived modules should call it from their constructors.
 	Module(std::string name) {
 		id = name;
+		index_ = FC_register_module(this);
+		handle_ = FC_name_handle(name.c_str());
 		runlevel_ = MODULE_RUNLEVEL_ERROR;
+		task_priority_ = TASK_PRIORITY_IO;
+		task_deadline_us_ = 0;
+		uses_interrupt_ = false;
+		tasks_coalesced_ = 0;
+		deadline_misses_ = 0;
 	};
 	
     // All modules have a setup() method that is intended for
@@ -69,8 +82,11 @@ public:
     // During setup, only messages to system_log are possible.
     virtual void setup() = 0;
     
-    // All registered modules receive calls to this interrupt service routine
-    // from the 1ms systick interrupt.
+    // Modules can receive calls to this interrupt service routine
+    // from the 1ms systick interrupt. This is optional, only modules which
+    // set uses_interrupt_ in their constructor are called. Most modules do
+    // not need it, their work is triggered by messages arriving at their
+    // ports (see ReceiverPort::set_handler()) or by kernel timers.
     // The interrupt routine should do no significant amount of work.
     // It should take no more than 50us (30000 CPU cycles), otherwise,
     // this will reported as a timing violation to the system log.
@@ -78,14 +94,42 @@ public:
     // worker functions for execution using the schedule_task() call.
     // Every call to a worker function should return in well below a millisecond.
     // If necessary, larger amounts of work need to be distributed over several calls.
-    virtual void interrupt() = 0;
+    virtual void interrupt() {};
+    
+    // if the interrupt() routine should be called with every systick
+    bool uses_interrupt() { return uses_interrupt_; };
     
     // we need a virtual destructor for destroying lists of objects
-    virtual ~Module() {};
+    virtual ~Module() { FC_unregister_module(index_); };
     
     // query the internal state of the module
     int8_t state() { return runlevel_; };
     
+    // the index under which the module is registered with the kernel
+    uint8_t index() { return index_; };
+    
+    // the handle of the module name, this identifies the module as sender of messages
+    uint16_t handle() { return handle_; };
+    
+    // the priority level with which tasks of this module are scheduled
+    uint8_t task_priority() { return task_priority_; };
+    
+    // the deadline (in us after the request) by which tasks of this module
+    // should have been started, unless another one is explicitly given
+    uint32_t task_deadline()
+        { return (task_deadline_us_ != 0) ? task_deadline_us_ : task_default_deadline(task_priority_); };
+    
+    // the number of task requests that have been dropped because
+    // the same task of this module was still waiting in the task queue
+    // we can read the latest value or reset it to zero (used by the watchdog)
+    uint32_t tasks_coalesced() { return tasks_coalesced_; };
+    void reset_tasks_coalesced() { tasks_coalesced_ = 0; };
+    
+    // the number of tasks of this module that have been started after their deadline
+    // we can read the latest value or reset it to zero (used by the watchdog)
+    uint32_t deadline_misses() { return deadline_misses_; };
+    void reset_deadline_misses() { deadline_misses_ = 0; };
+    
 public:
     
     // All modules have a short name which is used to reference the modules
@@ -93,6 +137,14 @@ public:
     // should have 8 characters at max.
     std::string id;
 
+    // The timing statistics of the module recorded by the kernel (in CPU cycles) :
+    // the time spent in interrupt(), the runtime of its tasks and
+    // the time from the request of a task until it has been started.
+    // Use CycleHistogram::snapshot() to evaluate them.
+    CycleHistogram isr_time_histogram;
+    CycleHistogram task_runtime_histogram;
+    CycleHistogram task_delay_histogram;
+
     // All message ports, that a module may have should be declared public
     // so they can be wired easily during system build
     
@@ -106,6 +158,37 @@ protected:
     // Modules may define their own mappings
     int8_t runlevel_;
 
+    // All tasks of the module are scheduled with this priority level
+    // unless another one is explicitly given. The default is TASK_PRIORITY_IO,
+    // modules can change it in their constructor (see kernel.h)
+    uint8_t task_priority_;
+
+    // The default deadline of all tasks of the module in us.
+    // If left zero, the default deadline of the priority level is used (see kernel.h).
+    uint32_t task_deadline_us_;
+
+    // Modules that need to be called from the systick interrupt
+    // (e.g. to poll hardware) have to set this flag in their constructor.
+    bool uses_interrupt_;
+
+private:
+
+    // the index of the module in the kernel registry
+    uint8_t index_;
+
+    // the handle of the interned module name
+    uint16_t handle_;
+
+    // The kernel keeps track of the tasks of this module waiting in the task queue.
+    // A task that is already pending is not scheduled again.
+    friend class TaskQueue;
+    TaskDelegate pending_tasks_[MODULE_MAX_PENDING_TASKS];
+    volatile uint32_t tasks_coalesced_;
+    
+    // deadline misses are counted by the main loop when a task is started
+    friend void kernel_loop();
+    volatile uint32_t deadline_misses_;
+
 public:
 
     // All modules have a port over which status messages are sent.
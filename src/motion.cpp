@@ -22,9 +22,15 @@ MotionSensor::MotionSensor(
     gyr_x = 0.0;
     gyr_y = 0.0;
     gyr_z = 0.0;
+    ahrs_cycles = 0;
+    gyro_cycles = 0;
     last_calib_check = 0;
     last_cal_state = 0;
     runlevel_= MODULE_RUNLEVEL_STOP;
+    // the sensor readout is part of the control loop
+    task_priority_ = TASK_PRIORITY_CONTROL;
+    // the sensor is polled with every systick
+    uses_interrupt_ = true;
 }
 
 void MotionSensor::setup()
@@ -35,7 +41,7 @@ void MotionSensor::setup()
     // set fast mode I²C
     Wire.setClock(400000);
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "BNO-055 setup()") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "BNO-055 setup()") );
     bno055_OK = true;
     
     // check ID registers
@@ -45,14 +51,14 @@ void MotionSensor::setup()
     {
         bno055_OK = false;
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 wrong chip ID") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 wrong chip ID") );
     };
     bno055->readReg(0x36, &tmp, 1);
     if (tmp != 0x0F)
     {
         bno055_OK = false;
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 self-test failed.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 self-test failed.") );
     };    
     // reset() is performed during the begin() procedure
     // remapping the axes is done inside the begin() method
@@ -60,12 +66,12 @@ void MotionSensor::setup()
     // Thereafter the sensor is switched to NDOF fusion mode
     while(bno055->begin() != BNO055::eStatusOK) {
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 begin() failed.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 begin() failed.") );
         bno055_OK = false;
         delay(2000);
     }
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "BNO-055 begin() success.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "BNO-055 begin() success.") );
 
     // configure sensor
     // the sensor settings can only be altered while in non-fusion modes
@@ -112,7 +118,7 @@ void MotionSensor::setup()
     // external crystal ??
 
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "BNO-055 initialized.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "BNO-055 initialized.") );
 
     // read calibration data from file
     bool data_OK = false;
@@ -137,12 +143,12 @@ void MotionSensor::setup()
         delay(50);
         bno055->writeReg(BNO055::ACCEL_OFFSET_X_LSB_ADDR, data, 22);
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "BNO-055 calibrated from file.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "BNO-055 calibrated from file.") );
     }
     else
     {
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, "error reading BNO-055 calibration data file.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, "error reading BNO-055 calibration data file.") );
     };
     
     // switch to sensor fusion mode
@@ -173,12 +179,12 @@ void MotionSensor::check_calibration()
         std::string report("calibration status : ");
         report += hexbyte(cal);
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, report) );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, report) );
     }
     if (cal>=(uint8_t)0xc0)
     {
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_MILESTONE, "up and running.") );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_MILESTONE, "up and running.") );
         runlevel_= MODULE_RUNLEVEL_OPERATIONAL;
     }    
 }
@@ -188,29 +194,29 @@ void MotionSensor::interrupt()
     // this is the normal operation mode with fast queries
     // directly within the interrupt routine
     if (runlevel_ >= MODULE_RUNLEVEL_OPERATIONAL)
-        schedule_task(this, std::bind(&MotionSensor::read_sensor, this));
+        schedule_task(this, TaskDelegate::create<MotionSensor, &MotionSensor::read_sensor>(this));
     // when we don't have reached fully operational state yet, check the calibration
     else if (runlevel_ >= MODULE_RUNLEVEL_SETUP_OK)
         if (FC_elapsed_millis(last_calib_check)>1000)
-            schedule_task(this, std::bind(&MotionSensor::check_calibration, this));
+            schedule_task(this, TaskDelegate::create<MotionSensor, &MotionSensor::check_calibration>(this));
 }
 
 void MotionSensor::report_quat_size_mismatch()
 {
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 quaternion data size mismatch.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 quaternion data size mismatch.") );
 }
 
 void MotionSensor::report_gyro_size_mismatch()
 {
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 gyro data size mismatch.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, "BNO-055 gyro data size mismatch.") );
 }
 
 void MotionSensor::report_cycles_overrun()
 {
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_WARNING, "IMU loop exceeding 10 cycles.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_WARNING, "IMU loop exceeding 10 cycles.") );
 }
 
 void MotionSensor::read_sensor()
@@ -250,8 +256,11 @@ void MotionSensor::read_sensor()
             {
                 uint8_t n_bytes = bno055->NonBlockingRead_available();
                 if (n_bytes == sizeof(raw))
+                {
                     // copy the data from buffer
                     bno055->NonBlockingRead_getData((uint8_t*) &raw, (uint8_t)sizeof(raw));
+                    ahrs_cycles = FC_cycle_count();
+                }
                 else
                     report_quat_size_mismatch();
                 // we only continue, if the request was fulfilled
@@ -270,7 +279,8 @@ void MotionSensor::read_sensor()
                 .attitude = pitch,
                 .heading = heading,
                 .roll = roll };
-            AHRS_out.transmit(data);
+            // stamped with the time of the measurement
+            AHRS_out.transmit(data, ahrs_cycles);
             query_state++;
             break;
         };
@@ -305,8 +315,11 @@ void MotionSensor::read_sensor()
             {
                 uint8_t n_bytes = bno055->NonBlockingRead_available();
                 if (n_bytes == sizeof(gyr))
+                {
                     // copy the data from buffer
                     bno055->NonBlockingRead_getData((uint8_t*) &gyr, (uint8_t)sizeof(gyr));
+                    gyro_cycles = FC_cycle_count();
+                }
                 else
                     report_gyro_size_mismatch();
                 // we only continue, if the request was fulfilled
@@ -326,7 +339,7 @@ void MotionSensor::read_sensor()
                 .nick = gyr_y,
                 .yaw = gyr_z,
                 .roll = gyr_x };
-            GYRO_out.transmit(data);
+            GYRO_out.transmit(data, gyro_cycles);
             query_state++;
             break;
         };
@@ -111,4 +111,7 @@ private:
                                 // this is counting run cycles 1..10 creating the 100 Hz update rate
     int         cycle_count;    // we count the number of cycles one loop actually takes.
     
+    uint64_t    ahrs_cycles;    // the time when the quaternion data were read (see FC_cycle_count())
+    uint64_t    gyro_cycles;    // the time when the gyro data were read
+    
 };
@@ -0,0 +1,148 @@
+#include <atomic>
+#include <cstdlib>
+
+#include "pool.h"
+
+// the layout of the arena - all size classes follow each other
+static const uint16_t pool_block_size[POOL_NUM_CLASSES] =
+    { 16, 32, 64, 128, 256 };
+static const uint16_t pool_num_blocks[POOL_NUM_CLASSES] =
+    { POOL_BLOCKS_16, POOL_BLOCKS_32, POOL_BLOCKS_64, POOL_BLOCKS_128, POOL_BLOCKS_256 };
+
+#define POOL_OFFSET_32  (16*POOL_BLOCKS_16)
+#define POOL_OFFSET_64  (POOL_OFFSET_32 + 32*POOL_BLOCKS_32)
+#define POOL_OFFSET_128 (POOL_OFFSET_64 + 64*POOL_BLOCKS_64)
+#define POOL_OFFSET_256 (POOL_OFFSET_128 + 128*POOL_BLOCKS_128)
+#define POOL_ARENA_SIZE (POOL_OFFSET_256 + 256*POOL_BLOCKS_256)
+
+static const uint32_t pool_offset[POOL_NUM_CLASSES+1] =
+    { 0, POOL_OFFSET_32, POOL_OFFSET_64, POOL_OFFSET_128, POOL_OFFSET_256, POOL_ARENA_SIZE };
+
+static_assert(POOL_BLOCKS_16 < 65536 and POOL_BLOCKS_32 < 65536 and POOL_BLOCKS_64 < 65536
+    and POOL_BLOCKS_128 < 65536 and POOL_BLOCKS_256 < 65536,
+    "blocks are linked by a 16-bit index");
+
+static uint8_t pool_arena[POOL_ARENA_SIZE] __attribute__ ((aligned (8)));
+
+/*
+    The free blocks of every class are kept in a stack linked through the
+    blocks themselves (the first 16 bit of a free block hold the index+1 of the next one).
+    The head word holds the index+1 of the top block in the lower 16 bit,
+    zero marks an empty stack. The upper 16 bit are incremented with every change,
+    so a compare-and-swap never succeeds on a head that has been popped and
+    pushed again in between (ABA problem).
+    Blocks that have never been used are not on the stack, they are handed out
+    in sequence using the fresh counter. This way all data are valid when
+    zero-initialized and the pool can be used before any constructor has run.
+*/
+struct PoolClass
+{
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> fresh;
+    std::atomic<uint32_t> in_use;
+    std::atomic<uint32_t> high_water;
+    std::atomic<uint32_t> exhausted;
+};
+
+static PoolClass pool_class[POOL_NUM_CLASSES];
+
+static inline uint16_t* pool_link(int c, uint32_t index)
+{
+    return (uint16_t*)(pool_arena + pool_offset[c] + index * pool_block_size[c]);
+}
+
+// take a block from the given class, null if there is none left
+static void* pool_take(int c)
+{
+    PoolClass *pc = &pool_class[c];
+    void *block = 0;
+    uint32_t head = pc->head.load();
+    while ((head & 0xFFFF) != 0)
+    {
+        uint32_t index = (head & 0xFFFF) - 1;
+        uint16_t next = *pool_link(c, index);
+        uint32_t new_head = ((head + 0x10000) & 0xFFFF0000) | next;
+        if (pc->head.compare_exchange_weak(head, new_head))
+        {
+            block = pool_link(c, index);
+            break;
+        };
+    };
+    if (block == 0)
+    {
+        // no free block, use one that has never been used before
+        uint32_t index = pc->fresh.fetch_add(1);
+        if (index >= pool_num_blocks[c])
+        {
+            // the class is used up, undo the increment
+            pc->fresh.fetch_sub(1);
+            return 0;
+        };
+        block = pool_link(c, index);
+    };
+    uint32_t used = pc->in_use.fetch_add(1) + 1;
+    uint32_t hw = pc->high_water.load();
+    while ((used > hw) and !pc->high_water.compare_exchange_weak(hw, used)) {};
+    return block;
+}
+
+// return a block to the given class
+static void pool_give(int c, void *block)
+{
+    PoolClass *pc = &pool_class[c];
+    uint32_t index = ((uint8_t*)block - (pool_arena + pool_offset[c])) / pool_block_size[c];
+    uint32_t head = pc->head.load();
+    do {
+        *pool_link(c, index) = head & 0xFFFF;
+    } while (!pc->head.compare_exchange_weak(head, ((head + 0x10000) & 0xFFFF0000) | (index+1)));
+    pc->in_use.fetch_sub(1);
+}
+
+void* FC_pool_alloc(size_t size)
+{
+    if (size == 0) return 0;
+    // find the smallest class that fits
+    int c = 0;
+    while ((c < POOL_NUM_CLASSES) and (pool_block_size[c] < size)) c++;
+    if (c >= POOL_NUM_CLASSES)
+    {
+        // too large for any class
+        pool_class[POOL_NUM_CLASSES-1].exhausted.fetch_add(1);
+        return malloc(size);
+    };
+    void *block = pool_take(c);
+    if (block != 0) return block;
+    pool_class[c].exhausted.fetch_add(1);
+    // try the larger classes
+    for (int larger = c+1; larger < POOL_NUM_CLASSES; larger++)
+    {
+        block = pool_take(larger);
+        if (block != 0) return block;
+    };
+    return malloc(size);
+}
+
+void FC_pool_free(void* ptr)
+{
+    if (ptr == 0) return;
+    uint8_t *p = (uint8_t*)ptr;
+    if ((p < pool_arena) or (p >= pool_arena + POOL_ARENA_SIZE))
+    {
+        // this block came from the heap
+        free(ptr);
+        return;
+    };
+    uint32_t offset = p - pool_arena;
+    int c = 0;
+    while (offset >= pool_offset[c+1]) c++;
+    pool_give(c, ptr);
+}
+
+uint16_t FC_pool_block_size(int size_class) { return pool_block_size[size_class]; };
+uint16_t FC_pool_num_blocks(int size_class) { return pool_num_blocks[size_class]; };
+uint16_t FC_pool_in_use(int size_class) { return pool_class[size_class].in_use.load(); };
+uint16_t FC_pool_high_water(int size_class) { return pool_class[size_class].high_water.load(); };
+void FC_pool_reset_high_water(int size_class)
+    { pool_class[size_class].high_water.store(pool_class[size_class].in_use.load()); };
+uint32_t FC_pool_exhausted(int size_class) { return pool_class[size_class].exhausted.load(); };
+void FC_pool_reset_exhausted(int size_class) { pool_class[size_class].exhausted.store(0); };
@@ -0,0 +1,61 @@
+/*
+    This is the memory pool used for the payload of messages.
+
+    Messages are created, copied and destroyed all the time, partly from
+    interrupt context. Using malloc/free for their payload fragments the heap
+    and takes an unpredictable amount of time. Instead, the payload is taken
+    from fixed-size blocks of a few size classes which are carved from a static
+    arena. Every size class keeps a stack of free blocks, blocks are handed out
+    and returned with a single compare-and-swap, so this is O(1), lock-free
+    and can be used from interrupt and task context alike.
+
+    If all blocks of a size class are in use, a block of the next larger class
+    is used. Only if that fails as well (or the requested size is larger than
+    the largest class) the memory is taken from the heap. This is counted as
+    an exhaustion of the size class and reported by the watchdog.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// the number of size classes and their block sizes (16, 32, 64, 128, 256 bytes)
+#define POOL_NUM_CLASSES 5
+#define POOL_MIN_BLOCK_SIZE 16
+#define POOL_MAX_BLOCK_SIZE 256
+
+// the number of blocks in every size class
+#define POOL_BLOCKS_16  128
+#define POOL_BLOCKS_32  128
+#define POOL_BLOCKS_64  64
+#define POOL_BLOCKS_128 32
+#define POOL_BLOCKS_256 16
+
+// get a memory block of at least the requested size
+// for a size of zero a null pointer is returned
+void* FC_pool_alloc(size_t size);
+
+// return a memory block obtained from FC_pool_alloc()
+// (this may be a null pointer)
+void FC_pool_free(void* ptr);
+
+// the block size of the given size class
+uint16_t FC_pool_block_size(int size_class);
+
+// the number of blocks of the given size class
+uint16_t FC_pool_num_blocks(int size_class);
+
+// the number of blocks of the given size class currently in use
+uint16_t FC_pool_in_use(int size_class);
+
+// we record the largest number of blocks in use for every size class
+// we can read the latest value or reset it to the current usage (used by the watchdog)
+uint16_t FC_pool_high_water(int size_class);
+void FC_pool_reset_high_water(int size_class);
+
+// we count the requests that could not be served from their size class
+// (the requests larger than the largest block are counted for the largest class)
+// we can read the latest value or reset it to zero (used by the watchdog)
+uint32_t FC_pool_exhausted(int size_class);
+void FC_pool_reset_exhausted(int size_class);
@@ -1,3 +1,6 @@
+#include <cstdlib>
+#include <new>
+#include <utility>
 #include "port.h"
 #include "global.h"
 
@@ -6,32 +9,159 @@ void SenderPort::set_receiver(ReceiverPort *receiver)
     list_of_receivers.push_back(receiver);
 };
 
-void SenderPort::transmit(Message message)
+bool SenderPort::transmit(const Message& message)
 {
+    bool accepted = true;
     for (auto const& port : list_of_receivers) {
-        port->receive(message);
+        if (!port->receive(message)) accepted = false;
     }
+    return accepted;
 };
 
+bool SenderPort::transmit(Message&& message)
+{
+    if (list_of_receivers.empty()) return true;
+    bool accepted = true;
+    // all but the last receiver get a copy
+    auto last = std::prev(list_of_receivers.end());
+    for (auto it = list_of_receivers.begin(); it != last; it++)
+        if (!(*it)->receive(message)) accepted = false;
+    // the last one gets the original
+    if (!(*last)->receive(std::move(message))) accepted = false;
+    return accepted;
+};
+
+
+
+
+ReceiverPort::ReceiverPort()
+{
+    owner = 0;
+    ring_ = 0;
+    capacity_ = 0;
+    head_ = 0;
+    fill_ = 0;
+    policy_ = PORT_OVERFLOW_DROP_NEWEST;
+    high_water_ = 0;
+    dropped_ = 0;
+}
+
+ReceiverPort::~ReceiverPort()
+{
+    while (fill_ > 0) fetch();
+    free(ring_);
+}
+
+void ReceiverPort::set_capacity(uint16_t capacity, uint8_t policy)
+{
+    // empty the current queue, all messages are moved into the new ring
+    std::list<Message> waiting;
+    while (count() > 0) waiting.push_back(fetch());
+    free(ring_);
+    ring_ = (Message*) malloc(capacity * sizeof(Message));
+    capacity_ = (ring_ != 0) ? capacity : 0;
+    head_ = 0;
+    fill_ = 0;
+    policy_ = policy;
+    for (auto& msg : waiting) push(std::move(msg));
+};
+
+void ReceiverPort::set_handler(Module *mod, TaskFunct f)
+{
+    owner = mod;
+    handler = f;
+};
 
+bool ReceiverPort::make_room()
+{
+    if ((capacity_ == 0) or (fill_ < capacity_)) return true;
+    dropped_++;
+    if (policy_ != PORT_OVERFLOW_DROP_OLDEST) return false;
+    // discard the oldest message
+    fetch();
+    return true;
+};
+
+bool ReceiverPort::push(Message&& message)
+{
+    if (!make_room()) return false;
+    if (capacity_ == 0)
+        queue.push_back(std::move(message));
+    else
+        new (&ring_[(head_+fill_++) % capacity_]) Message(std::move(message));
+    return true;
+};
 
+bool ReceiverPort::receive(const Message& message)
+{
+    // the copy shares the data blob, it is just moved into the queue
+    return receive(Message(message));
+};
 
-void ReceiverPort::receive(Message message)
+bool ReceiverPort::receive(Message&& message)
 {
-    queue.push_back(message);
+    if (!push(std::move(message))) return (policy_ != PORT_OVERFLOW_REJECT);
+    notify();
+    return true;
+};
+
+void ReceiverPort::notify()
+{
+    uint16_t depth = count();
+    if (depth > high_water_) high_water_ = depth;
+    FC_TRACE(TRACE_PORT_RECEIVE, (owner != 0) ? owner->index() : MODULE_INDEX_NONE, depth);
+    if (owner != 0)
+        schedule_task(owner, handler);
 };
 
 uint16_t ReceiverPort::count()
 {
-    return queue.size();
+    return (capacity_ == 0) ? queue.size() : fill_;
 };
 
 Message ReceiverPort::fetch()
 {
-    // get the first message
-    Message msg = queue.front();
-    // remove it from the list
-    queue.pop_front();
+    if (capacity_ == 0)
+    {
+        // get the first message
+        Message msg = std::move(queue.front());
+        // remove it from the list
+        queue.pop_front();
+        return msg;
+    };
+    // take the oldest message out of the ring
+    Message msg = std::move(ring_[head_]);
+    ring_[head_].~Message();
+    head_ = (head_+1) % capacity_;
+    fill_--;
     return msg;
 };
 
+Message* ReceiverPort::peek(uint16_t *n)
+{
+    if (capacity_ == 0)
+    {
+        *n = queue.empty() ? 0 : 1;
+        return queue.empty() ? 0 : &queue.front();
+    };
+    // the block ends at the end of the ring
+    uint16_t contiguous = capacity_ - head_;
+    *n = (fill_ < contiguous) ? fill_ : contiguous;
+    return &ring_[head_];
+};
+
+void ReceiverPort::consume(uint16_t n)
+{
+    while ((n > 0) and (count() > 0))
+    {
+        if (capacity_ == 0)
+            queue.pop_front();
+        else
+        {
+            ring_[head_].~Message();
+            head_ = (head_+1) % capacity_;
+            fill_--;
+        };
+        n--;
+    };
+};
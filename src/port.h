@@ -15,10 +15,19 @@
 
 #include <cstdlib>
 #include <list>
+#include "kernel.h"
 #include "message.h"
 
 class ReceiverPort;
 
+// What a receiver port with a bounded queue does with a message arriving while the queue is full :
+// DROP_NEWEST - the new message is discarded
+// DROP_OLDEST - the oldest message in the queue is discarded to make room for the new one
+// REJECT      - the new message is discarded and the sender is told so (transmit() returns false)
+#define PORT_OVERFLOW_DROP_NEWEST 0
+#define PORT_OVERFLOW_DROP_OLDEST 1
+#define PORT_OVERFLOW_REJECT      2
+
 /*
  * This port is intended for asynchronous communication.
  * The sender transmits one message and does not care about it anymore.
@@ -30,7 +39,15 @@ class SenderPort {
         // there can be set several receivers that all will get
         // the messages sent through this port
         void set_receiver(ReceiverPort *receiver);
-        void transmit(Message message);
+        // Every receiver gets a copy of the message (sharing the data blob).
+        // A temporary message is moved to the last receiver, so with a single
+        // receiver the message is passed on without being copied at all.
+        // This returns false if any of the receivers rejected the message (see ReceiverPort).
+        bool transmit(const Message& message);
+        bool transmit(Message&& message);
+        // if any receiver is wired to this port
+        // (a sender can skip assembling messages nobody receives)
+        bool connected() { return !list_of_receivers.empty(); };
     protected:
         std::list<ReceiverPort*> list_of_receivers;
 };
@@ -40,18 +57,80 @@ class SenderPort {
  * Whenever the connected sender decides to send a message it gets stored
  * in the input queue associated with this port.
  * It sits there until it is processed by the module owning this port.
+ * The owning module can register a handler task which is scheduled
+ * right away whenever a message arrives.
+ *
+ * By default the queue can grow without limit. If the receiving module
+ * may stall (waiting for a modem or an SD card) the queue should be bounded
+ * when the system is wired. Then the messages are kept in a ring buffer
+ * of fixed size, and messages arriving while it is full are dropped
+ * according to the overflow policy of the port.
  */
 class ReceiverPort {
     public:
+        ReceiverPort();
+        ~ReceiverPort();
+        // ports are not copied
+        ReceiverPort(const ReceiverPort&) = delete;
+        ReceiverPort& operator=(const ReceiverPort&) = delete;
+        // Bound the queue to the given number of messages with the given
+        // overflow policy (PORT_OVERFLOW_xxx). This is done during system build,
+        // messages already waiting are kept (up to the capacity).
+        void set_capacity(uint16_t capacity, uint8_t policy);
+        // The module owning the port can register a task which is scheduled
+        // whenever a message is received. This usually happens in the constructor.
+        // As a task is not scheduled a second time while it is pending,
+        // the handler has to process all messages available (or reschedule itself).
+        void set_handler(Module *mod, TaskFunct handler);
         // When a sender decides to send a message to this port it will 
         // call this method. The receiver port will store the message
-        // and do nothing else.
-        void receive(Message message);
+        // and schedule the handler of the owning module (if any).
+        // A temporary message is moved into the queue.
+        // This returns false if the message was rejected (full queue with PORT_OVERFLOW_REJECT).
+        bool receive(const Message& message);
+        bool receive(Message&& message);
         // The module owning the port must query the number of messages available
         uint16_t count();
         // The module can fetch the message from the queue for processing.
+        // The message is moved out of the queue.
+        // It must only be called if count() is not zero.
         Message fetch();
+        // Access the oldest messages without moving them out of the queue.
+        // This returns a pointer to the oldest message, n is set to the number
+        // of messages following it in memory (0 if the queue is empty).
+        // An unbounded queue gives one message at a time.
+        // The messages stay valid until they are released with consume().
+        Message* peek(uint16_t *n);
+        // release the given number of the oldest messages (at most count())
+        void consume(uint16_t n);
+        // the number of messages dropped or rejected because the queue was full
+        // we can read the latest value or reset it to zero
+        uint32_t dropped() { return dropped_; };
+        void reset_dropped() { dropped_ = 0; };
+        // the largest number of messages waiting in the queue
+        // we can read the latest value or reset it to the current depth
+        uint16_t high_water() { return high_water_; };
+        void reset_high_water() { high_water_ = count(); };
     protected:
+        // make room for one more message, false if the new one has to be dropped
+        bool make_room();
+        // put a message into the queue, false if it was dropped
+        bool push(Message&& message);
+        // a message was queued - update the statistics and
+        // schedule the handler of the owning module
+        void notify();
+        // the unbounded queue
         std::list<Message> queue;
+        // the ring buffer of a bounded queue (capacity_ != 0)
+        // the slots are raw memory, messages are constructed in place
+        Message     *ring_;
+        uint16_t    capacity_;
+        uint16_t    head_;
+        uint16_t    fill_;
+        uint8_t     policy_;
+        uint16_t    high_water_;
+        uint32_t    dropped_;
+        Module      *owner;
+        TaskFunct   handler;
 };
 
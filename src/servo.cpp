@@ -15,6 +15,10 @@ Servo8chDriver::Servo8chDriver(
     std::string name
     ) : Module(name)
 {
+    // the servo output is part of the control loop
+    task_priority_ = TASK_PRIORITY_CONTROL;
+    // incoming messages are handled immediately
+    in.set_handler(this, TaskDelegate::create<Servo8chDriver, &Servo8chDriver::handle_message>(this));
     // set the port pins as input (not active)
     activate(0);
 	
@@ -34,31 +38,18 @@ Servo8chDriver::Servo8chDriver(
 	};
 }
 
-void Servo8chDriver::interrupt()
-{
-    // a message is pending - schedule handler
-    if (in.count()>0)
-        schedule_task(this, std::bind(&Servo8chDriver::handle_message, this));
-}
-
 void Servo8chDriver::handle_message()
 {
     // we go through all messages pending
     while (in.count()>0)
     {
-        Message msg = in.fetch();
-        // handle only servo messages
-        if (msg.type() == MSG_TYPE_SERVO)
-        {
-            // get a pointer to the data struct
-            MSG_DATA_SERVO *data = (MSG_DATA_SERVO *) msg.get_data();
-            // update the settings
-            set_pos(data->pos);
-        }
+        TypedMessage<MSG_DATA_SERVO> msg = in.fetch();
+        // update the settings
+        set_pos(msg.data().pos);
     }
 }
 
-void Servo8chDriver::set_pos(short int value[NUM_SERVO_CHANNELS])
+void Servo8chDriver::set_pos(const short int value[NUM_SERVO_CHANNELS])
 {
     for (int i=0; i<NUM_SERVO_CHANNELS; i++)
     {
@@ -7,12 +7,13 @@
 #include "module.h"
 #include "message.h"
 #include "port.h"
+#include "typed_port.h"
 
 
 /*  
     This is a module for driving 8 servo channels.
     The pulse output is running all the time after the Servo8chDriver has been created.
-    It can receive MESSAGE_SERVO to set the output value(s).
+    It can receive MSG_TYPE_SERVO messages to set the output value(s).
     
     The data range is defined as -1000 ... 1000
     which is mapped to an output pulse with 1.0...2.0 ms
@@ -32,25 +33,21 @@ public:
     // nothing to do
     virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
     
-    // This gets called once per millisecond from the systick interrupt.
-    // When necessary worker tasks are scheduled to switch the LED.
-    virtual void interrupt();
-
     // This is the worker function being executed by the taskmanager.
-    // It sets the output for all servo channels.
+    // It is scheduled when a message arrives at the input port
+    // and sets the output for all servo channels.
     void handle_message();
 
     // destructor
     virtual ~Servo8chDriver() {};
 
-    // port at which arbitrary messages are received
-    // only MESSAGE_SERVO type messages are evaluated
-    ReceiverPort in;
+    // port at which the servo messages are received
+    TypedReceiverPort<MSG_DATA_SERVO> in;
 
     // Set the output values.
     // This could be used during setup before the module can process messages
     // but also later on circumventing the message system.
-    void set_pos(short int value[NUM_SERVO_CHANNELS]);
+    void set_pos(const short int value[NUM_SERVO_CHANNELS]);
     
     // Activate a set of output channels.
     // The mask contains one bit for every servo channel indicating
@@ -1,48 +1,249 @@
+#include <atomic>
+#include <cstring>
+
 #include "stream.h"
 #include "global.h"
 #include "message.h" // for the data types
 
 template <typename datatype>
-void StreamSender<datatype>::set_receiver(StreamReceiver<datatype> *receiver)
+void StreamSender<datatype>::set_receiver(StreamInput<datatype> *receiver)
 {
     list_of_receivers.push_back(receiver);
 };
 
 template <typename datatype>
 void StreamSender<datatype>::transmit(datatype data)
+{
+    transmit(data, FC_cycle_count());
+};
+
+template <typename datatype>
+void StreamSender<datatype>::transmit(datatype data, uint64_t cycles)
 {
     for (auto const& port : list_of_receivers) {
-        port->receive(data);
+        port->receive(data, cycles);
     }
 };
 
 
 
 template <typename datatype>
-void StreamReceiver<datatype>::receive(datatype data)
+StreamReceiver<datatype>::StreamReceiver() :
+    tail_(0), overruns_(0), head_(0), buffer_(0), mask_(0), owner(0)
+{
+    set_capacity(STREAM_DEFAULT_CAPACITY);
+};
+
+template <typename datatype>
+StreamReceiver<datatype>::~StreamReceiver()
+{
+    delete[] buffer_;
+};
+
+template <typename datatype>
+void StreamReceiver<datatype>::set_capacity(uint16_t capacity)
 {
-    queue.push_back(data);
+    uint32_t size = 1;
+    while ((size < capacity) and (size < 32768)) size <<= 1;
+    delete[] buffer_;
+    buffer_ = new StreamSample<datatype>[size];
+    mask_ = size - 1;
+    head_.store(0);
+    tail_.store(0);
+};
+
+template <typename datatype>
+void StreamReceiver<datatype>::set_handler(Module *mod, TaskFunct f)
+{
+    owner = mod;
+    handler = f;
+};
+
+template <typename datatype>
+void StreamReceiver<datatype>::receive(datatype data, uint64_t cycles)
+{
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t head = head_.load(std::memory_order_acquire);
+    if (tail - head > mask_)
+    {
+        // the queue is full, the receiver has to catch up
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    };
+    buffer_[tail & mask_].cycles = cycles;
+    buffer_[tail & mask_].data = data;
+    // the data block is visible to the receiver only after it has been stored
+    tail_.store(tail + 1, std::memory_order_release);
+    FC_TRACE(TRACE_PORT_RECEIVE, (owner != 0) ? owner->index() : MODULE_INDEX_NONE, tail + 1 - head);
+    if (owner != 0)
+        schedule_task(owner, handler);
 };
 
 template <typename datatype>
 uint16_t StreamReceiver<datatype>::count()
 {
-    return queue.size();
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_relaxed);
 };
 
 template <typename datatype>
 datatype StreamReceiver<datatype>::fetch()
 {
-    // get the first message
-    datatype data = queue.front();
-    // remove it from the list
-    queue.pop_front();
+    return fetch_sample().data;
+};
+
+template <typename datatype>
+StreamSample<datatype> StreamReceiver<datatype>::fetch_sample()
+{
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    StreamSample<datatype> data = buffer_[head & mask_];
+    // the slot can be re-used by the sender only after it has been read
+    head_.store(head + 1, std::memory_order_release);
     return data;
 };
 
+template <typename datatype>
+uint16_t StreamReceiver<datatype>::fetch_n(datatype *out, uint16_t max)
+{
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t n = tail_.load(std::memory_order_acquire) - head;
+    if (n > max) n = max;
+    for (uint32_t i=0; i<n; i++)
+        out[i] = buffer_[(head + i) & mask_].data;
+    // all slots are released at once
+    head_.store(head + n, std::memory_order_release);
+    return n;
+};
+
+template <typename datatype>
+uint16_t StreamReceiver<datatype>::fetch_n(StreamSample<datatype> *out, uint16_t max)
+{
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t n = tail_.load(std::memory_order_acquire) - head;
+    if (n > max) n = max;
+    for (uint32_t i=0; i<n; i++)
+        out[i] = buffer_[(head + i) & mask_];
+    head_.store(head + n, std::memory_order_release);
+    return n;
+};
+
+template <typename datatype>
+const StreamSample<datatype>* StreamReceiver<datatype>::peek(uint16_t *n)
+{
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t available = tail_.load(std::memory_order_acquire) - head;
+    // the block ends at the end of the buffer
+    uint32_t contiguous = mask_ + 1 - (head & mask_);
+    *n = (available < contiguous) ? available : contiguous;
+    return &buffer_[head & mask_];
+};
+
+template <typename datatype>
+void StreamReceiver<datatype>::consume(uint16_t n)
+{
+    head_.store(head_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+};
+
+template <typename datatype>
+void StreamMailbox<datatype>::set_handler(Module *mod, TaskFunct f)
+{
+    owner = mod;
+    handler = f;
+};
+
+template <typename datatype>
+void StreamMailbox<datatype>::receive(datatype data, uint64_t cycles)
+{
+    uint32_t words[NUM_WORDS];
+    words[0] = (uint32_t)cycles;
+    words[1] = (uint32_t)(cycles >> 32);
+    std::memcpy(words+2, &data, sizeof(datatype));
+    uint32_t seq = seq_.load(std::memory_order_relaxed);
+    // mark the data as being written
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i=0; i<NUM_WORDS; i++)
+        words_[i].store(words[i], std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+    FC_TRACE(TRACE_PORT_RECEIVE, (owner != 0) ? owner->index() : MODULE_INDEX_NONE, 1);
+    if (owner != 0)
+        schedule_task(owner, handler);
+};
+
+template <typename datatype>
+uint32_t StreamMailbox<datatype>::read(datatype *data, uint64_t *cycles)
+{
+    uint32_t words[NUM_WORDS];
+    uint32_t before, after;
+    do {
+        before = seq_.load(std::memory_order_acquire);
+        for (int i=0; i<NUM_WORDS; i++)
+            words[i] = words_[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq_.load(std::memory_order_relaxed);
+        // repeat if the sender was writing before or during the copy
+    } while ((before & 1) or (before != after));
+    if (before == 0) return 0;
+    std::memcpy(data, words+2, sizeof(datatype));
+    if (cycles != 0) *cycles = ((uint64_t)words[1] << 32) | words[0];
+    return before / 2;
+};
+
+template <typename datatype>
+StreamAdapter<datatype>::StreamAdapter(uint8_t mode, uint16_t n, float alpha) :
+    mode_(mode), window_((n > 0) ? n : 1), alpha_(alpha), count_(0), first_cycles_(0), started_(false)
+{
+    for (int i=0; i<NUM_VALUES; i++) acc_[i] = 0.0;
+};
+
+template <typename datatype>
+void StreamAdapter<datatype>::receive(datatype data, uint64_t cycles)
+{
+    if (count_ == 0) first_cycles_ = cycles;
+    float values[NUM_VALUES];
+    std::memcpy(values, &data, sizeof(datatype));
+    for (int i=0; i<NUM_VALUES; i++)
+    {
+        float &acc = acc_[i];
+        switch (mode_)
+        {
+            case STREAM_ADAPTER_AVERAGE:
+                acc = (count_ == 0) ? values[i] : acc + values[i];
+                break;
+            case STREAM_ADAPTER_EXPONENTIAL:
+                acc = started_ ? acc + alpha_ * (values[i] - acc) : values[i];
+                break;
+            case STREAM_ADAPTER_MINIMUM:
+                if ((count_ == 0) or (values[i] < acc)) acc = values[i];
+                break;
+            case STREAM_ADAPTER_MAXIMUM:
+                if ((count_ == 0) or (values[i] > acc)) acc = values[i];
+                break;
+            default:
+                acc = values[i];
+                break;
+        };
+    };
+    started_ = true;
+    if (++count_ < window_) return;
+    // the window is complete
+    if (mode_ == STREAM_ADAPTER_AVERAGE)
+    {
+        for (int i=0; i<NUM_VALUES; i++) values[i] = acc_[i] / window_;
+        cycles = first_cycles_ + (cycles - first_cycles_) / 2;
+    }
+    else
+        for (int i=0; i<NUM_VALUES; i++) values[i] = acc_[i];
+    count_ = 0;
+    std::memcpy(&data, values, sizeof(datatype));
+    out.transmit(data, cycles);
+};
 
 // we have to instantiate the classes for every possible data type
 template class StreamSender<DATA_IMU_AHRS>;
 template class StreamReceiver<DATA_IMU_AHRS>;
+template class StreamMailbox<DATA_IMU_AHRS>;
+template class StreamAdapter<DATA_IMU_AHRS>;
 template class StreamSender<DATA_IMU_GYRO>;
 template class StreamReceiver<DATA_IMU_GYRO>;
+template class StreamMailbox<DATA_IMU_GYRO>;
+template class StreamAdapter<DATA_IMU_GYRO>;
@@ -2,19 +2,53 @@
     In addition to sending/receiving messages, modules can communicate
     with streams. These are intended for small fixed-type data blocks
     that need to be exchanged at high rate. The sender just broadcasts
-    data blocks of known type to all registered receivers without any metadata.
+    data blocks of known type to all registered receivers. The only metadata
+    is the time the data block was produced, taken from the 64-bit CPU cycle
+    counter (see FC_cycle_count()). It is kept along with the data through
+    all receivers and adapters, so the data can be stamped with the time
+    of the measurement rather than the time they are processed.
 */
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <list>
 
+#include "kernel.h"
 #include "types.h"
 
+// the number of data blocks a stream receiver can hold unless set otherwise
+#ifndef STREAM_DEFAULT_CAPACITY
+#define STREAM_DEFAULT_CAPACITY 16
+#endif
+
+// the size of a cache line (32 bytes on the Cortex-M7)
+// data written by the sender and the receiver are kept this far apart
+#ifndef STREAM_CACHE_LINE
+#define STREAM_CACHE_LINE 32
+#endif
+
+// a data block together with the time it was produced
+template <typename datatype>
+struct StreamSample {
+    uint64_t    cycles;     // FC_cycle_count() when the data were produced
+    datatype    data;
+};
+
+/*
+ * Everything a stream sender can be wired to.
+ * The receivers differ in how they keep the data (see below).
+ */
 template <typename datatype>
-class StreamReceiver;
+class StreamInput {
+    public:
+        virtual ~StreamInput() {};
+        // this is called by the sender for every data block
+        // with the time it was produced (see StreamSender::transmit())
+        virtual void receive(datatype data, uint64_t cycles) = 0;
+};
 
 /*
  * This port is intended for asynchronous communication.
@@ -27,10 +61,14 @@ class StreamSender {
     public:
         // there can be set several receivers that all will get
         // the messages sent through this port
-        void set_receiver(StreamReceiver<datatype> *receiver);
+        void set_receiver(StreamInput<datatype> *receiver);
+        // the data are stamped with the current time
         void transmit(datatype data);
+        // The data are stamped with the given time (FC_cycle_count()).
+        // This is used if the data were measured before they are sent.
+        void transmit(datatype data, uint64_t cycles);
     protected:
-        std::list<StreamReceiver<datatype>*> list_of_receivers;
+        std::list<StreamInput<datatype>*> list_of_receivers;
 };
 
 /*
@@ -38,19 +76,167 @@ class StreamSender {
  * Whenever the connected sender decides to send a data block it gets stored
  * in the input queue associated with this port.
  * It sits there until it is processed by the module owning this port.
+ * The owning module can register a handler task which is scheduled
+ * right away whenever data arrives.
+ *
+ * The queue is a ring buffer of fixed size (a power of 2) allocated
+ * when the port is created or wired, nothing is allocated per data block.
+ * There must be only one sender (interrupt or task) and the owning module
+ * as the only reader. Then storing and fetching are wait-free without locking.
+ * A data block arriving while the queue is full is dropped and counted.
  */
 template <typename datatype>
-class StreamReceiver {
+class StreamReceiver : public StreamInput<datatype> {
     public:
+        StreamReceiver();
+        virtual ~StreamReceiver();
+        // ports are not copied
+        StreamReceiver(const StreamReceiver&) = delete;
+        StreamReceiver& operator=(const StreamReceiver&) = delete;
+        // Set the number of data blocks the queue can hold, this is rounded up
+        // to a power of 2 (at most 32768). This is done during system build,
+        // data already waiting are discarded.
+        void set_capacity(uint16_t capacity);
+        uint16_t capacity() { return mask_ + 1; };
+        // The module owning the port can register a task which is scheduled
+        // whenever data is received (see ReceiverPort::set_handler()).
+        void set_handler(Module *mod, TaskFunct handler);
         // When a sender decides to send a message to this port it will 
         // call this method. The receiver port will store the message
-        // and do nothing else.
-        void receive(datatype data);
+        // and schedule the handler of the owning module (if any).
+        virtual void receive(datatype data, uint64_t cycles);
         // The module owning the port must query the number of messages available
         uint16_t count();
         // The module can fetch the message from the queue for processing.
+        // It must only be called if count() is not zero.
         datatype fetch();
+        // the same with the time the data were produced
+        StreamSample<datatype> fetch_sample();
+        // Fetch up to max data blocks at once into the given array
+        // (with or without the time they were produced).
+        // This returns the number of data blocks fetched.
+        uint16_t fetch_n(datatype *out, uint16_t max);
+        uint16_t fetch_n(StreamSample<datatype> *out, uint16_t max);
+        // Access the oldest data blocks without copying them.
+        // This returns a pointer to the oldest data block, n is set to the number
+        // of data blocks following it in memory (0 if the queue is empty).
+        // The data stay valid until they are released with consume().
+        const StreamSample<datatype>* peek(uint16_t *n);
+        // release the given number of the oldest data blocks (at most count())
+        void consume(uint16_t n);
+        // the number of data blocks dropped because the queue was full
+        // we can read the latest value or reset it to zero
+        uint32_t overruns() { return overruns_.load(std::memory_order_relaxed); };
+        void reset_overruns() { overruns_.store(0, std::memory_order_relaxed); };
+    protected:
+        // The indices run freely, the slot is taken modulo the capacity.
+        // The sender only writes tail_ and overruns_, the receiver only writes head_.
+        // They are kept on different cache lines, so the sender and the receiver
+        // do not invalidate each other's cache line with every data block.
+        std::atomic<uint32_t> tail_;
+        std::atomic<uint32_t> overruns_;
+        uint8_t     pad_tail_[STREAM_CACHE_LINE];
+        std::atomic<uint32_t> head_;
+        uint8_t     pad_head_[STREAM_CACHE_LINE];
+        // these are only changed during system build
+        StreamSample<datatype> *buffer_;
+        uint32_t    mask_;
+        Module      *owner;
+        TaskFunct   handler;
+};
+
+
+/*
+ * A receiver for modules that only need the current state (e.g. a display).
+ * Only the latest data block is kept, every new one replaces it.
+ * So the receiver never grows, however slowly the module reads it.
+ *
+ * The mailbox is written by one sender (interrupt or task) without waiting.
+ * A read running while the sender replaces the data is repeated,
+ * so the data read are never a mix of two data blocks (sequence lock).
+ * Therefore the mailbox must not be read from an interrupt that may
+ * interrupt the sender.
+ * The data are kept as 32-bit words, so every access is a single atomic load or store.
+ */
+template <typename datatype>
+class StreamMailbox : public StreamInput<datatype> {
+    static_assert(sizeof(datatype) % 4 == 0, "the data are kept as 32-bit words");
+    public:
+        StreamMailbox() : seq_(0), owner(0) {};
+        // ports are not copied
+        StreamMailbox(const StreamMailbox&) = delete;
+        StreamMailbox& operator=(const StreamMailbox&) = delete;
+        // A task can be registered to be scheduled whenever data are received.
+        // Usually a module reads the mailbox whenever it needs the data instead.
+        void set_handler(Module *mod, TaskFunct handler);
+        // the sender replaces the data
+        virtual void receive(datatype data, uint64_t cycles);
+        // the number of data blocks received so far
+        // (this can be compared with the value returned by read() to detect new data)
+        uint32_t sequence() { return seq_.load(std::memory_order_acquire) / 2; };
+        // Copy the latest data block (and the time it was produced if cycles is given).
+        // This returns its sequence number, 0 if nothing has been received yet
+        // (data and cycles are left unchanged then).
+        uint32_t read(datatype *data, uint64_t *cycles = 0);
     protected:
-        std::list<datatype> queue;
+        // the time (2 words) followed by the data
+        static const int NUM_WORDS = 2 + sizeof(datatype)/4;
+        // incremented before and after the data are replaced (odd while writing)
+        std::atomic<uint32_t> seq_;
+        std::atomic<uint32_t> words_[NUM_WORDS];
+        Module      *owner;
+        TaskFunct   handler;
 };
 
+// What a stream adapter does with the data blocks of a window of N :
+// DECIMATE    - only the last data block is passed on
+// AVERAGE     - the mean of all data blocks is passed on (boxcar)
+// EXPONENTIAL - every data block updates an exponential average,
+//               the current average is passed on (alpha is the weight of a new data block)
+// MINIMUM     - the smallest value of every member is passed on
+// MAXIMUM     - the largest value of every member is passed on
+#define STREAM_ADAPTER_DECIMATE     0
+#define STREAM_ADAPTER_AVERAGE      1
+#define STREAM_ADAPTER_EXPONENTIAL  2
+#define STREAM_ADAPTER_MINIMUM      3
+#define STREAM_ADAPTER_MAXIMUM      4
+
+/*
+ * An adapter sits between a stream sender and receivers that need the data
+ * at a lower rate. It is wired like a receiver, its output is wired like a sender.
+ * For every N data blocks received one data block is sent on,
+ * it is computed according to the mode of the adapter (STREAM_ADAPTER_xxx).
+ * It is stamped with the time of the last data block of the window,
+ * an average with the middle of the window.
+ * Adapters can be chained (e.g. average by 5, then maximum by 10).
+ *
+ * The data blocks are processed as an array of floats, so all members
+ * of the data type must be floats (all IMU data types are).
+ * The adapter is created while the system is built and runs in the context
+ * of the sender, without any allocation and without scheduling a task.
+ */
+template <typename datatype>
+class StreamAdapter : public StreamInput<datatype> {
+    static_assert(sizeof(datatype) % sizeof(float) == 0, "the data are processed as floats");
+    public:
+        StreamAdapter(uint8_t mode, uint16_t n, float alpha = 0.1);
+        // ports are not copied
+        StreamAdapter(const StreamAdapter&) = delete;
+        StreamAdapter& operator=(const StreamAdapter&) = delete;
+        // the data block from the sender
+        virtual void receive(datatype data, uint64_t cycles);
+        // the receivers of the reduced stream are wired here
+        StreamSender<datatype> out;
+    protected:
+        static const int NUM_VALUES = sizeof(datatype) / sizeof(float);
+        uint8_t     mode_;
+        uint16_t    window_;
+        float       alpha_;
+        // the number of data blocks received in the current window
+        uint16_t    count_;
+        // the time of the first data block of the window
+        uint64_t    first_cycles_;
+        // the accumulated values (the exponential average is kept across windows)
+        float       acc_[NUM_VALUES];
+        bool        started_;
+};
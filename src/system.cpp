@@ -7,7 +7,12 @@ DisplaySSD1331 *display;
 StreamFileWriter* fast_log_file_writer;
 DummyGPS *gps;
 MotionSensor *imu;
+StreamAdapter<DATA_IMU_AHRS> *display_ahrs;
+StreamAdapter<DATA_IMU_GYRO> *display_gyro;
 Modem *modem;
+#if KERNEL_TRACE
+TraceFileWriter* trace_file_writer;
+#endif
 
 void FC_init_system()
 {
@@ -31,6 +36,14 @@ void FC_init_system()
     // sprintf(log_filename, "taros.%05d.fast.log", SD_file_No);
     // fast_log_file_writer = new StreamFileWriter("FASTLOG",std::string(log_filename));
 
+#if KERNEL_TRACE
+    // create a writer dumping the kernel trace 10 seconds after start
+    char trace_filename[40];
+    sprintf(trace_filename, "taros.%05d.trace.bin", SD_file_No);
+    trace_file_writer = new TraceFileWriter("TRACE",std::string(trace_filename), 10000);
+    trace_file_writer->status_out.set_receiver(&(system_log->in));
+#endif
+
     // create a modem for communication with a ground station
     modem = new Modem(std::string("MODEM_1"));
     modem->status_out.set_receiver(&(system_log->in));
@@ -82,6 +95,12 @@ void FC_setup_system(
     // if (fast_log_file_writer->state() >= MODULE_RUNLEVEL_SETUP_OK)
     // 	module_list->push_back(fast_log_file_writer);
     
+#if KERNEL_TRACE
+    trace_file_writer->setup();
+    if (trace_file_writer->state() >= MODULE_RUNLEVEL_SETUP_OK)
+        module_list->push_back(trace_file_writer);
+#endif
+
     // create a modem for communication with a ground station
     modem->setup();
     if (modem->state() >= MODULE_RUNLEVEL_SETUP_OK)
@@ -123,6 +142,8 @@ void FC_build_system()
 
     // wire the syslog output to the modem for communication with a ground station
     // TODO : this leads to lots of systick overruns
+    // the modem is slow, if it cannot keep up the oldest messages are dropped
+    modem->downlink.set_capacity(32, PORT_OVERFLOW_DROP_OLDEST);
     system_log->system_out.set_receiver(&(modem->downlink));
 
     // wire the modem uplink to the commander
@@ -132,10 +153,23 @@ void FC_build_system()
     gps->tm_out.set_receiver(&(system_log->in));
     
     // wire the motion controller
-    imu->AHRS_out.set_receiver(&(display->ahrs_in));
-    imu->GYRO_out.set_receiver(&(display->gyro_in));
-    imu->AHRS_out.set_receiver(&(fast_log_file_writer->ahrs_in));
-    imu->GYRO_out.set_receiver(&(fast_log_file_writer->gyro_in));
+    // the display gets the data reduced to 10 Hz
+    // (the angles are not averaged as the heading wraps around at 360 degree)
+    display_ahrs = new StreamAdapter<DATA_IMU_AHRS>(STREAM_ADAPTER_DECIMATE, 10);
+    display_gyro = new StreamAdapter<DATA_IMU_GYRO>(STREAM_ADAPTER_AVERAGE, 10);
+    imu->AHRS_out.set_receiver(display_ahrs);
+    imu->GYRO_out.set_receiver(display_gyro);
+    display_ahrs->out.set_receiver(&(display->ahrs_in));
+    display_gyro->out.set_receiver(&(display->gyro_in));
+    // the stream file writer may not have been created
+    if (fast_log_file_writer != 0)
+    {
+        // the SD card may stall for a while, the file writer gets a deeper queue (1.28 s at 100 Hz)
+        fast_log_file_writer->ahrs_in.set_capacity(128);
+        fast_log_file_writer->gyro_in.set_capacity(128);
+        imu->AHRS_out.set_receiver(&(fast_log_file_writer->ahrs_in));
+        imu->GYRO_out.set_receiver(&(fast_log_file_writer->gyro_in));
+    };
     
     
     // create a logger capturing telemetry data at specified rate
@@ -22,6 +22,9 @@ extern StreamFileWriter* fast_log_file_writer;
 extern DummyGPS *gps;
 extern MotionSensor *imu;
 extern Modem *modem;
+#if KERNEL_TRACE
+extern TraceFileWriter* trace_file_writer;
+#endif
 
 // -- actually defined in main.cpp --
 extern Logger* system_log;
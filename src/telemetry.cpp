@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "kernel.h"
+#include "telemetry.h"
+#include "util.h"
+
+// The variables are kept in a hash table with open addressing.
+// It has twice the number of slots than variables, so the probe sequences stay short.
+#define TELEMETRY_SLOTS (2*TELEMETRY_MAX_VARIABLES)
+
+static_assert((TELEMETRY_SLOTS & (TELEMETRY_SLOTS-1)) == 0, "the number of slots must be a power of 2");
+
+// a slot is empty as long as the name is a null pointer
+static TelemetryEntry telemetry_table[TELEMETRY_SLOTS];
+static uint16_t telemetry_count;
+
+uint16_t FC_telemetry_hash(uint16_t sender, const char* variable)
+{
+    // this is only done when a variable is declared
+    std::string key = std::string(FC_name(sender)) + "." + variable;
+    return crc16((const uint8_t*)key.data(), key.size());
+}
+
+bool FC_telemetry_register(uint16_t hash, uint16_t sender, const char* variable)
+{
+    uint16_t slot = hash & (TELEMETRY_SLOTS-1);
+    while (telemetry_table[slot].name != 0)
+    {
+        TelemetryEntry* v = &telemetry_table[slot];
+        if (v->hash == hash)
+            // already registered - or a collision with another variable
+            return (v->sender == sender) and (strcmp(v->name, variable) == 0);
+        slot = (slot+1) & (TELEMETRY_SLOTS-1);
+    };
+    if (telemetry_count >= TELEMETRY_MAX_VARIABLES) return false;
+    telemetry_table[slot].hash = hash;
+    telemetry_table[slot].sender = sender;
+    // the name is set last, it marks the slot as used
+    telemetry_table[slot].name = strdup(variable);
+    telemetry_count++;
+    return true;
+}
+
+bool FC_telemetry_declare(uint16_t sender, const char* variable, uint16_t *hash)
+{
+    *hash = FC_telemetry_hash(sender, variable);
+    return FC_telemetry_register(*hash, sender, variable);
+}
+
+const TelemetryEntry* FC_telemetry_lookup(uint16_t hash)
+{
+    uint16_t slot = hash & (TELEMETRY_SLOTS-1);
+    while (telemetry_table[slot].name != 0)
+    {
+        if (telemetry_table[slot].hash == hash) return &telemetry_table[slot];
+        slot = (slot+1) & (TELEMETRY_SLOTS-1);
+    };
+    return 0;
+}
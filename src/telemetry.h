@@ -0,0 +1,47 @@
+/*
+    Telemetry data are sent as compact binary records.
+    
+    A module first declares every telemetry variable it is going to send
+    (see FC_telemetry_declare()). The declaration assigns a 16-bit hash
+    to the combination of sender and variable name and registers it here.
+    Only if that succeeds the declaration message (see Message::TelemetryVariable())
+    announces the hash to all receivers.
+    After that every sample is sent as a data message (see Message::DataMessage())
+    just holding the hash, the timestamp and the binary value.
+    
+    Only receivers that need text (logger, log files) look up the variable
+    by its hash in this registry when they format the record. Declaration
+    messages received over a communication link are registered as well,
+    so the data of a remote system can be decoded in the same way.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// the maximum number of telemetry variables that can be registered
+#define TELEMETRY_MAX_VARIABLES 64
+
+struct TelemetryEntry {
+    uint16_t    hash;
+    // the handle of the sender name (see FC_name_handle())
+    uint16_t    sender;
+    // the variable name
+    const char* name;
+};
+
+// the hash of a variable of the given sender (CRC-16 of "sender.variable")
+uint16_t FC_telemetry_hash(uint16_t sender, const char* variable);
+
+// Register a telemetry variable. Registering the same variable again does no harm.
+// This returns false if the hash is already taken by another variable
+// or the registry is full.
+bool FC_telemetry_register(uint16_t hash, uint16_t sender, const char* variable);
+
+// Compute the hash of a variable of the given sender and register it.
+// The hash is returned in hash. This returns false if the variable could not
+// be registered, it must not be sent then. Any value of the hash is valid.
+bool FC_telemetry_declare(uint16_t sender, const char* variable, uint16_t *hash);
+
+// the variable registered with the given hash (0 if there is none)
+const TelemetryEntry* FC_telemetry_lookup(uint16_t hash);
@@ -0,0 +1,114 @@
+/*
+    A typed layer over messages and message ports.
+
+    A TypedMessage<T> is a message carrying exactly one data struct T.
+    The message type and size are bound to T at compile time (see MessageType below),
+    so the data can be accessed without checking the type and casting a pointer.
+    Small structs are stored inside the message (see MESSAGE_INLINE_SIZE).
+
+    TypedSenderPort<T> and TypedReceiverPort<T> can only be wired to each other
+    if they carry the same struct, a mismatch fails to compile.
+    Apart from that they behave exactly like SenderPort and ReceiverPort.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "message.h"
+#include "port.h"
+#include "types.h"
+
+/*
+    The message type of every data struct that can be sent as a TypedMessage.
+    Using a struct not listed here fails to compile.
+*/
+template <typename T>
+struct MessageType;
+
+template <> struct MessageType<MSG_DATA_GPS_POSITION>
+    { static const uint16_t id = MSG_TYPE_GPS_POSITION; };
+template <> struct MessageType<MSG_DATA_SERVO>
+    { static const uint16_t id = MSG_TYPE_SERVO; };
+template <> struct MessageType<DATA_IMU_AHRS>
+    { static const uint16_t id = MSG_TYPE_IMU_AHRS; };
+template <> struct MessageType<DATA_IMU_GYRO>
+    { static const uint16_t id = MSG_TYPE_IMU_GYRO; };
+
+template <typename T>
+class TypedReceiverPort;
+
+template <typename T>
+class TypedSenderPort;
+
+template <typename T>
+class TypedMessage {
+    static_assert(std::is_trivially_copyable<T>::value,
+        "the data of a message are copied as a blob of bytes");
+    public:
+        // the message is created from the sender handle (see Module::handle()) and the data
+        TypedMessage(uint16_t sender, const T& data) :
+            msg_(sender, MessageType<T>::id, sizeof(T), (void*)&data) {};
+
+        // read-only access to the data
+        const T& data() { return *(const T*)msg_.data(); };
+
+        // access to the data for modification (see Message::get_data())
+        T& get_data() { return *(T*)msg_.get_data(); };
+
+        // the handle and name of the sender
+        uint16_t sender() { return msg_.sender(); };
+        const char* sender_name() { return msg_.sender_name(); };
+
+        // the untyped message (e.g. for printing or serializing it)
+        Message& message() { return msg_; };
+
+    private:
+        // only a typed port can re-create a typed message from an untyped one
+        explicit TypedMessage(Message&& msg) : msg_(std::move(msg)) {};
+        friend class TypedReceiverPort<T>;
+        friend class TypedSenderPort<T>;
+        Message msg_;
+};
+
+/*
+ * A receiver port for messages carrying the data struct T.
+ * See ReceiverPort for the details.
+ */
+template <typename T>
+class TypedReceiverPort {
+    public:
+        void set_handler(Module *mod, TaskFunct handler) { port_.set_handler(mod, handler); };
+        void set_capacity(uint16_t capacity, uint8_t policy) { port_.set_capacity(capacity, policy); };
+        bool receive(const TypedMessage<T>& message) { return port_.receive(message.msg_); };
+        bool receive(TypedMessage<T>&& message) { return port_.receive(std::move(message.msg_)); };
+        uint16_t count() { return port_.count(); };
+        // the message is moved out of the queue
+        // it must only be called if count() is not zero
+        TypedMessage<T> fetch() { return TypedMessage<T>(port_.fetch()); };
+        uint32_t dropped() { return port_.dropped(); };
+        void reset_dropped() { port_.reset_dropped(); };
+        uint16_t high_water() { return port_.high_water(); };
+        void reset_high_water() { port_.reset_high_water(); };
+    private:
+        friend class TypedSenderPort<T>;
+        ReceiverPort port_;
+};
+
+/*
+ * A sender port for messages carrying the data struct T.
+ * See SenderPort for the details.
+ */
+template <typename T>
+class TypedSenderPort {
+    public:
+        void set_receiver(TypedReceiverPort<T> *receiver) { port_.set_receiver(&receiver->port_); };
+        bool transmit(const TypedMessage<T>& message) { return port_.transmit(message.msg_); };
+        bool transmit(TypedMessage<T>&& message) { return port_.transmit(std::move(message.msg_)); };
+        // create the message right away
+        bool transmit(uint16_t sender, const T& data) { return port_.transmit(TypedMessage<T>(sender, data).msg_); };
+    private:
+        SenderPort port_;
+};
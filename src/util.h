@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 std::string hexbyte(char c);
 std::string hexbyte(int i);
 std::string hexbyte(uint8_t ab);
+
+// CRC-16 (CCITT, polynomial 0x1021, initial value 0xFFFF) of a block of data
+uint16_t crc16(const uint8_t* data, size_t size);
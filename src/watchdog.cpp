@@ -4,9 +4,10 @@
 #include <iomanip>
 
 // this is needed to have F_CPU_ACTUAL
-#include "../core/wiring.h"
+#include "wiring.h"
 
 #include "kernel.h"
+#include "pool.h"
 #include "watchdog.h"
 #include "util.h"
 
@@ -16,32 +17,37 @@ Watchdog::Watchdog(
     ) : Module(name)
 {
     rate_ms = repetition_ms;
+    health_timer = -1;
+    memory_timer = -1;
     runlevel_ = MODULE_RUNLEVEL_STOP;
+    task_priority_ = TASK_PRIORITY_HOUSEKEEPING;
 }
 
 void Watchdog::setup()
 {
-    health_delay_counter = 0;
-    memory_delay_counter = rate_ms / 2;
+    // the memory report is shifted by half a period against the health report
+    health_timer = schedule_periodic_task(this,
+        TaskDelegate::create<Watchdog, &Watchdog::analyze_health>(this), rate_ms, 0);
+    memory_timer = schedule_periodic_task(this,
+        TaskDelegate::create<Watchdog, &Watchdog::analyze_memory>(this), rate_ms, rate_ms/2);
+    if ((health_timer < 0) or (memory_timer < 0))
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_ERROR, "no kernel timer available.") );
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATE_CHANGE, "initialized.") );
     runlevel_ = MODULE_RUNLEVEL_OPERATIONAL;
 };
 
-void Watchdog::interrupt()
+Watchdog::~Watchdog()
 {
-    health_delay_counter++;
-    memory_delay_counter++;
-    if (health_delay_counter > rate_ms)
-    {
-        health_delay_counter=0;
-        schedule_task(this, std::bind(&Watchdog::analyze_health, this));
-    }
-    if (memory_delay_counter > rate_ms)
-    {
-        memory_delay_counter=0;
-        schedule_task(this, std::bind(&Watchdog::analyze_memory, this));
-    }
+    cancel_timer(this, health_timer);
+    cancel_timer(this, memory_timer);
+};
+
+// convert CPU cycles to microseconds
+static float cycles_to_us(uint32_t cycles)
+{
+    return 1e6*(float)cycles/(float)F_CPU_ACTUAL;
 }
 
 void Watchdog::analyze_health()
@@ -55,7 +61,7 @@ void Watchdog::analyze_health()
     float delay = 1.0e6 * (float)FC_get_max_isr_spacing() / (float)F_CPU_ACTUAL;
     report1 << " -- spacing : " << delay << " us";
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report1.str()) );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATUSREPORT, report1.str()) );
 
     // report potentially delayed systick interrupts
     if (delay>1100.0)
@@ -65,7 +71,7 @@ void Watchdog::analyze_health()
         report2 << std::fixed << std::setprecision(1);
         report2 << delay << " us)";
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, report2.str()) );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, report2.str()) );
     }
     
     // report potentially delayed task starts
@@ -77,7 +83,7 @@ void Watchdog::analyze_health()
         report3 << std::fixed << std::setprecision(1);
         report3 << delay << " us";
         status_out.transmit(
-            Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_CRITICAL, report3.str()) );
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, report3.str()) );
     }
     
     // report longest module runtime
@@ -86,13 +92,87 @@ void Watchdog::analyze_health()
     report4 << FC_max_task_runtime_module_ID() << " : ";
     report4 << std::fixed << std::setprecision(1) << 1e6*(float)FC_get_max_task_runtime()/(float)F_CPU_ACTUAL << " us";
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report4.str()) );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATUSREPORT, report4.str()) );
+    
+    // report the task queue usage and tasks lost due to a full queue
+    std::stringstream report5;
+    report5 << "Task queue -- max depth : " << FC_get_task_queue_high_water();
+    report5 << " -- rejected : " << FC_get_task_queue_rejected();
+    uint8_t level = (FC_get_task_queue_rejected()>0) ? MSG_LEVEL_CRITICAL : MSG_LEVEL_STATUSREPORT;
+    status_out.transmit(
+        Message::SystemMessage(handle(), FC_time_now(), level, report5.str()) );
+    
+    // report all modules that have requested tasks which were still pending
+    std::stringstream report6;
+    report6 << "coalesced tasks";
+    bool coalesced = false;
+    for (Module* mod : module_list)
+    {
+        if (mod->tasks_coalesced() > 0)
+        {
+            report6 << " -- " << mod->id << " : " << mod->tasks_coalesced();
+            mod->reset_tasks_coalesced();
+            coalesced = true;
+        };
+    };
+    if (coalesced)
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATUSREPORT, report6.str()) );
+    
+    // report all modules with tasks that were started after their deadline
+    std::stringstream report7;
+    report7 << "deadline misses";
+    bool missed = false;
+    for (Module* mod : module_list)
+    {
+        if (mod->deadline_misses() > 0)
+        {
+            report7 << " -- " << mod->id << " : " << mod->deadline_misses();
+            mod->reset_deadline_misses();
+            missed = true;
+        };
+    };
+    if (missed)
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_CRITICAL, report7.str()) );
+    
+    // report the timing statistics of every module
+    for (Module* mod : module_list)
+    {
+        CycleHistogram isr, runtime, start_delay;
+        mod->isr_time_histogram.snapshot(&isr, true);
+        mod->task_runtime_histogram.snapshot(&runtime, true);
+        mod->task_delay_histogram.snapshot(&start_delay, true);
+        if ((isr.count() == 0) and (runtime.count() == 0)) continue;
+        std::stringstream report8;
+        report8 << mod->id << " timing p50/p99/max (us)";
+        report8 << std::fixed << std::setprecision(1);
+        if (isr.count() > 0)
+        {
+            report8 << " -- IRQ : " << cycles_to_us(isr.percentile(0.5));
+            report8 << " / " << cycles_to_us(isr.percentile(0.99));
+            report8 << " / " << cycles_to_us(isr.max());
+        };
+        if (runtime.count() > 0)
+        {
+            report8 << " -- task (" << runtime.count() << ") : " << cycles_to_us(runtime.percentile(0.5));
+            report8 << " / " << cycles_to_us(runtime.percentile(0.99));
+            report8 << " / " << cycles_to_us(runtime.max());
+            report8 << " -- delay : " << cycles_to_us(start_delay.percentile(0.5));
+            report8 << " / " << cycles_to_us(start_delay.percentile(0.99));
+            report8 << " / " << cycles_to_us(start_delay.max());
+        };
+        status_out.transmit(
+            Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATUSREPORT, report8.str()) );
+    };
     
     FC_reset_max_isr_time_to_completion();
     FC_reset_max_isr_spacing();
     FC_reset_max_isr_duration();
     FC_reset_max_task_delay();
     FC_reset_max_task_runtime();
+    FC_reset_task_queue_high_water();
+    FC_reset_task_queue_rejected();
     
 }
 
@@ -126,5 +206,27 @@ void Watchdog::analyze_memory()
     // report << " (" << __brkval-_heap_start << " bytes used)";
     // report << " -- stack usage " << stack_used() << " bytes";
     status_out.transmit(
-        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report.str()) );
+        Message::SystemMessage(handle(), FC_time_now(), MSG_LEVEL_STATUSREPORT, report.str()) );
+
+    // report the usage of the message pool
+    // for every size class the maximum number of blocks used and the available blocks
+    std::stringstream report2;
+    report2 << "Message pool";
+    uint32_t exhausted = 0;
+    for (int c=0; c<POOL_NUM_CLASSES; c++)
+    {
+        report2 << " -- " << FC_pool_block_size(c) << " : ";
+        report2 << FC_pool_high_water(c) << "/" << FC_pool_num_blocks(c);
+        exhausted += FC_pool_exhausted(c);
+        FC_pool_reset_high_water(c);
+    };
+    report2 << " -- exhausted :";
+    for (int c=0; c<POOL_NUM_CLASSES; c++)
+    {
+        report2 << " " << FC_pool_exhausted(c);
+        FC_pool_reset_exhausted(c);
+    };
+    uint8_t level = (exhausted>0) ? MSG_LEVEL_WARNING : MSG_LEVEL_STATUSREPORT;
+    status_out.transmit(
+        Message::SystemMessage(handle(), FC_time_now(), level, report2.str()) );
 }
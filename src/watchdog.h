@@ -21,25 +21,31 @@ public:
         uint32_t repetition_ms  // time between 2 health reports in ms
         );
 
+    // the periodic reports are registered with the kernel timers
     virtual void setup();
     
-    virtual void interrupt();
+    // the timers are cancelled
+    virtual ~Watchdog();
     
     // this will be called with the above defined repetition rate
     // the runtime spent in interrupt routines and module tasks is analyzed
     // the general interrupt timing and the longest module runtime are reported
-    // timing violations are reported separately
+    // timing violations (e.g. deadline misses of module tasks) are reported separately
+    // for every module the percentiles of ISR time, task runtime and task start delay are reported
     void analyze_health();
 	
     // this will be called with the above defined repetition rate
     // the stack and heap memory used by the application are reported
+    // as well as the usage of the message pool
 	void analyze_memory();
 
 private:
 
 	// the time in ms between two reports
     uint32_t rate_ms;
-    uint32_t health_delay_counter;
-	uint32_t memory_delay_counter;
+    
+    // the kernel timers of the reports (-1 if none)
+    int health_timer;
+    int memory_timer;
     
 };
@@ -0,0 +1,93 @@
+#include <string>
+#include <sstream>
+#include <iomanip>
+
+// this is needed to have ARM_DWT_CYCCNT
+#include "../core/core_pins.h"
+
+#include "kernel.h"
+#include "dispatch_timing.h"
+
+// the number of dispatches timed in one measurement
+#define DISPATCH_TIMING_COUNT 1000
+
+// the task descriptor as it was used with std::function
+struct LegacyTask
+{
+    Module* module;
+    uint32_t request_time;
+    std::function<void ()> funct;
+};
+
+DispatchTiming::DispatchTiming(
+    std::string name,
+    uint32_t repetition_ms
+    ) : Module(name)
+{
+    rate_ms = repetition_ms;
+    // the first measurement starts one second after the system start
+    delay_counter = repetition_ms - 1000;
+    call_count = 0;
+    runlevel_ = MODULE_RUNLEVEL_STOP;
+    task_priority_ = TASK_PRIORITY_HOUSEKEEPING;
+    uses_interrupt_ = true;
+}
+
+void DispatchTiming::interrupt()
+{
+    delay_counter++;
+    if (delay_counter > rate_ms)
+    {
+        delay_counter=0;
+        schedule_task(this, TaskDelegate::create<DispatchTiming, &DispatchTiming::measure>(this));
+    }
+}
+
+void __attribute__ ((noinline)) DispatchTiming::dummy_task()
+{
+    call_count++;
+}
+
+void DispatchTiming::measure()
+{
+    // old path : std::bind into std::function, 3 copies, call
+    uint32_t start = ARM_DWT_CYCCNT;
+    for (int i=0; i<DISPATCH_TIMING_COUNT; i++)
+    {
+        LegacyTask task = {
+            .module = this,
+            .request_time = ARM_DWT_CYCCNT,
+            .funct = std::bind(&DispatchTiming::dummy_task, this)
+            };
+        LegacyTask queued = task;
+        LegacyTask front = queued;
+        LegacyTask popped = front;
+        popped.funct();
+    };
+    uint32_t old_cycles = ARM_DWT_CYCCNT - start;
+    
+    // new path : TaskDelegate, 3 copies, call
+    start = ARM_DWT_CYCCNT;
+    for (int i=0; i<DISPATCH_TIMING_COUNT; i++)
+    {
+        Task task = {
+            .module = this,
+            .request_time = ARM_DWT_CYCCNT,
+            .funct = TaskDelegate::create<DispatchTiming, &DispatchTiming::dummy_task>(this),
+            .pending = -1
+            };
+        Task queued = task;
+        Task front = queued;
+        Task popped = front;
+        popped.funct();
+    };
+    uint32_t new_cycles = ARM_DWT_CYCCNT - start;
+    
+    std::stringstream report;
+    report << "dispatch cycles -- std::function : ";
+    report << std::fixed << std::setprecision(1) << (float)old_cycles / DISPATCH_TIMING_COUNT;
+    report << " -- TaskDelegate : ";
+    report << (float)new_cycles / DISPATCH_TIMING_COUNT;
+    status_out.transmit(
+        Message::SystemMessage(id, FC_time_now(), MSG_LEVEL_STATUSREPORT, report.str()) );
+}
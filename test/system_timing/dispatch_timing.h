@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+
+#include "module.h"
+#include "port.h"
+
+/*
+    This module compares the cost of the two ways to dispatch a task.
+    The old path creates a std::function from std::bind() and copies it
+    through the task descriptor three times (schedule, front of the list, pop).
+    The new path does the same with a TaskDelegate.
+    The average number of CPU cycles per dispatch is reported to the status_out
+    every time the measurement is repeated.
+*/
+class DispatchTiming : public Module
+{
+
+public:
+
+    // constructor
+    DispatchTiming(
+        std::string name,       // the ID of the module
+        uint32_t repetition_ms  // time between 2 measurements in ms
+        );
+
+    virtual void setup() { runlevel_ = MODULE_RUNLEVEL_OPERATIONAL; };
+    
+    virtual void interrupt();
+    
+    // this will be called with the above defined repetition rate
+    // it runs both dispatch paths a number of times and reports the timing
+    void measure();
+    
+    // this is the (empty) task being dispatched
+    void dummy_task();
+
+private:
+
+    uint32_t rate_ms;
+    uint32_t delay_counter;
+    volatile uint32_t call_count;
+    
+};
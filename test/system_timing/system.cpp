@@ -5,6 +5,7 @@ Blink *blink;
 Commander *commander;
 Watchdog *watchdog;
 Modem *modem;
+DispatchTiming *dispatch_timing;
 
 void FC_init_system()
 {
@@ -22,6 +23,10 @@ void FC_init_system()
     modem = new Modem(std::string("MODEM_1"));
     modem->status_out.set_receiver(&(system_log->in));
 
+    // compare the task dispatch timing every 10 seconds
+    dispatch_timing = new DispatchTiming(std::string("DISPATCH"), 10000);
+    dispatch_timing->status_out.set_receiver(&(system_log->in));
+
     // All start-up messages are just queued in the Logger
     system_log->in.receive(
         Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, "init() complete.")
@@ -48,6 +53,10 @@ void FC_setup_system(
     if (modem->state() >= MODULE_RUNLEVEL_SETUP_OK)
     	module_list->push_back(modem);
 
+    dispatch_timing->setup();
+    if (dispatch_timing->state() >= MODULE_RUNLEVEL_SETUP_OK)
+        module_list->push_back(dispatch_timing);
+
     // All start-up messages are just queued in the Logger
     system_log->in.receive(
         Message::SystemMessage("SYSTEM", FC_time_now(), MSG_LEVEL_MILESTONE, "all setup() complete.")
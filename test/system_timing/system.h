@@ -9,12 +9,14 @@
 #include "commander.h"
 #include "watchdog.h"
 #include "blink.h"
+#include "dispatch_timing.h"
 
 // all modules that will be included during the system build
 extern Blink *blink;
 extern Commander *commander;
 extern Watchdog *watchdog;
 extern Modem *modem;
+extern DispatchTiming *dispatch_timing;
 
 // -- actually defined in main.cpp --
 extern Logger* system_log;
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+
+"""
+This Python script converts a kernel trace written by the TraceFileWriter
+of a TAROS system (taros.xxxxx.trace.bin) into the Chrome trace event format.
+The result can be viewed with chrome://tracing or https://ui.perfetto.dev
+
+The systick interrupt, the module interrupt() calls and the task executions
+are shown as slices, task requests and messages received as instant events.
+
+usage : trace_to_chrome.py taros.00012.trace.bin [output.json]
+"""
+
+import sys
+import json
+import struct
+import argparse
+
+# the event types as defined in kernel.h
+TRACE_ISR_ENTER = 1
+TRACE_ISR_EXIT = 2
+TRACE_INTERRUPT_ENTER = 3
+TRACE_INTERRUPT_EXIT = 4
+TRACE_TASK_ENQUEUE = 5
+TRACE_TASK_START = 6
+TRACE_TASK_STOP = 7
+TRACE_PORT_RECEIVE = 8
+
+MODULE_INDEX_NONE = 255
+
+# the threads shown in the trace viewer
+TID_SYSTICK = 1
+TID_TASKS = 2
+
+parser = argparse.ArgumentParser()
+parser.add_argument('trace', help='the trace file written by the TraceFileWriter')
+parser.add_argument('output', nargs='?', help='the JSON file to be written', default=None)
+args = parser.parse_args()
+if args.output is None:
+    args.output = args.trace.rsplit('.', 1)[0] + '.json'
+
+with open(args.trace, 'rb') as f:
+    data = f.read()
+
+if data[0:8] != b'TAROSTRC':
+    print('not a TAROS trace file')
+    sys.exit(1)
+pos = 8
+clock, num_modules = struct.unpack_from('<II', data, pos)
+pos += 8
+modules = []
+for i in range(num_modules):
+    name = data[pos:pos+8].split(b'\0')[0].decode('ascii', 'replace')
+    modules.append(name)
+    pos += 8
+num_events, = struct.unpack_from('<I', data, pos)
+pos += 4
+print(f'{num_events} events of {num_modules} modules, CPU clock {clock/1e6:.0f} MHz')
+
+def module_name(index):
+    if index < len(modules) and modules[index]:
+        return modules[index]
+    return 'SYSTEM' if index == MODULE_INDEX_NONE else f'module {index}'
+
+events = []
+# the cycle counter is 32 bit, we unroll its wrap-around by adding up the
+# (signed) differences between successive events - an event may be a little
+# earlier than the one before if an interrupt recorded its event in between
+last_cycles = None
+first_cycles = None
+for n in range(num_events):
+    raw, ev_type, module, arg = struct.unpack_from('<IBBH', data, pos)
+    pos += 8
+    if last_cycles is None:
+        cycles = raw
+    else:
+        delta = (raw - last_raw) & 0xffffffff
+        if delta >= 1 << 31:
+            delta -= 1 << 32
+        cycles = last_cycles + delta
+    last_raw = raw
+    last_cycles = cycles
+    if first_cycles is None:
+        first_cycles = cycles
+    # time stamps in microseconds
+    ts = (cycles - first_cycles) * 1e6 / clock
+    name = module_name(module)
+    ev = {'pid': 1, 'ts': ts}
+    if ev_type == TRACE_ISR_ENTER:
+        ev.update(name='systick', ph='B', tid=TID_SYSTICK)
+    elif ev_type == TRACE_ISR_EXIT:
+        ev.update(name='systick', ph='E', tid=TID_SYSTICK)
+    elif ev_type == TRACE_INTERRUPT_ENTER:
+        ev.update(name=name, ph='B', tid=TID_SYSTICK, cat='interrupt')
+    elif ev_type == TRACE_INTERRUPT_EXIT:
+        ev.update(name=name, ph='E', tid=TID_SYSTICK, cat='interrupt')
+    elif ev_type == TRACE_TASK_ENQUEUE:
+        ev.update(name='schedule '+name, ph='i', s='t', tid=TID_TASKS,
+            cat='queue', args={'pending': arg})
+    elif ev_type == TRACE_TASK_START:
+        ev.update(name=name, ph='B', tid=TID_TASKS, cat='task', args={'pending': arg})
+    elif ev_type == TRACE_TASK_STOP:
+        ev.update(name=name, ph='E', tid=TID_TASKS, cat='task')
+    elif ev_type == TRACE_PORT_RECEIVE:
+        ev.update(name='receive '+name, ph='i', s='t', tid=TID_TASKS,
+            cat='port', args={'queued': arg})
+    else:
+        continue
+    events.append(ev)
+
+metadata = [
+    {'name': 'process_name', 'ph': 'M', 'pid': 1, 'args': {'name': 'TAROS'}},
+    {'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': TID_SYSTICK, 'args': {'name': 'systick ISR'}},
+    {'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': TID_TASKS, 'args': {'name': 'kernel loop'}},
+]
+
+with open(args.output, 'w') as f:
+    json.dump({'traceEvents': metadata + events, 'displayTimeUnit': 'ns'}, f)
+print('written '+args.output)